@@ -99,7 +99,7 @@ void main()
 
     if (idx < numShapesToCull)
     {
-        AABB box = _AABBs[_DrawCommands[idx].baseInstance >> 16];
+        AABB box = _AABBs[_DrawCommands[idx].baseInstance];
         uint numInstances = isAABBinFrustum(box) ? 1 : 0;
         _DrawCommands[idx].instanceCount = numInstances;
         atomicAdd(_NumVisibleMeshes, numInstances);
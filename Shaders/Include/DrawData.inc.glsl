@@ -0,0 +1,13 @@
+// Mirrors GPUDrawData, indexed by gl_BaseInstance.
+struct DrawData
+{
+    uint transformIndex;
+    uint materialIndex;
+    uint lod;
+    uint flags;
+};
+
+layout(std430, binding = 4) restrict readonly buffer DrawDataBuffer
+{
+    DrawData _drawData[];
+};
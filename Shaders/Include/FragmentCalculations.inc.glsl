@@ -25,6 +25,14 @@ mat3 CotangentFrame(vec3 N, vec3 p, vec2 uv)
     return mat3(T * invmax, B * invmax, N);
 }
 
+// Normal maps only store x and y (BC5), z is reconstructed. Returns the sample in [0, 1] range.
+vec3 DecodeNormalSample(vec2 sampleXY)
+{
+    vec2 xy = 2.0 * sampleXY - vec2(1.0);
+    float z = sqrt(clamp(1.0 - dot(xy, xy), 0.0, 1.0));
+    return vec3(sampleXY, 0.5 * z + 0.5);
+}
+
 vec3 PerturbNormal(vec3 n, vec3 v, vec3 normalSample, vec2 uv)
 {
     vec3 map = normalize(2.0 * normalSample - vec3(1.0));
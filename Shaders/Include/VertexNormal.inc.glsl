@@ -0,0 +1,17 @@
+/*
+ * Meshes either provide float normals at location 2 or octahedral encoded normals at location 3.
+ * The attribute that is not used is disabled and reads as (0, 0, 0, 1).
+ */
+vec3 OctahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += (n.x >= 0.0) ? -t : t;
+    n.y += (n.y >= 0.0) ? -t : t;
+    return normalize(n);
+}
+
+vec3 GetVertexNormal(vec3 normal, vec2 normalOct)
+{
+    return (dot(normal, normal) > 0.0) ? normal : OctahedralDecode(normalOct);
+}
@@ -54,7 +54,8 @@ void main()
     }
     if (material.normalMap > 0)
     {
-        normalSample = texture(sampler2D(unpackUint2x32(material.normalMap)), in_TexCoord).xyz;
+        normalSample = DecodeNormalSample(
+            texture(sampler2D(unpackUint2x32(material.normalMap)), in_TexCoord).xy);
     }
 
     vec3 worldNormal = normalize(in_WorldNormal);
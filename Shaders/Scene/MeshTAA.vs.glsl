@@ -8,6 +8,8 @@
 
 #include "Shaders/Include/SceneData.inc.glsl"
 #include "Shaders/Include/TAAFrameData.inc.glsl"
+#include "Shaders/Include/DrawData.inc.glsl"
+#include "Shaders/Include/VertexNormal.inc.glsl"
 
 layout(std430, binding = 1) restrict readonly buffer Matrices
 {
@@ -17,6 +19,7 @@ layout(std430, binding = 1) restrict readonly buffer Matrices
 layout(location = 0) in vec3 in_Vertex;
 layout(location = 1) in vec2 in_TexCoord;
 layout(location = 2) in vec3 in_Normal;
+layout(location = 3) in vec2 in_NormalOct;
 
 layout(location = 0) out vec2 out_TexCoord;
 layout(location = 1) out vec3 out_WorldNormal;
@@ -31,7 +34,8 @@ const mat4 scaleBias
 
 void main()
 {
-    mat4 model = _models[gl_BaseInstance >> 16];
+    DrawData drawData = _drawData[gl_BaseInstance];
+    mat4 model = _models[drawData.transformIndex];
     mat4 mvp = proj * view * model;
 
     vec4 clipPos = mvp * vec4(in_Vertex, 1.0);
@@ -42,9 +46,9 @@ void main()
     gl_Position = clipPosJittered;
 
     out_TexCoord = in_TexCoord;
-    out_WorldNormal = transpose(inverse(mat3(model))) * in_Normal;
-    out_WorldPos = (view * vec4(in_Vertex, 1.0)).xyz;
-    out_MaterialIndex = gl_BaseInstance & 0xffff;
+    out_WorldNormal = transpose(inverse(mat3(model))) * GetVertexNormal(in_Normal, in_NormalOct);
+    out_WorldPos = (view * model * vec4(in_Vertex, 1.0)).xyz;
+    out_MaterialIndex = drawData.materialIndex;
     out_ShadowCoord = scaleBias * light * model * vec4(in_Vertex, 1.0);
 
     // Setup data for velocity calculation.
@@ -1,5 +1,6 @@
 #version 460 core
 
+#include "Shaders/Include/DrawData.inc.glsl"
 #include "Shaders/Include/SceneData.inc.glsl"
 
 layout(std430, binding = 1) restrict readonly buffer Matrices
@@ -11,7 +12,7 @@ layout(location = 0) in vec3 in_Vertex;
 
 void main()
 {
-    mat4 model = _Models[gl_BaseInstance >> 16];
+    mat4 model = _Models[_drawData[gl_BaseInstance].transformIndex];
 
     // XXX: proj and view have been modified to be the light source's inside the CPU program.
     // Maybe add additional params to the scene data instead of modifying it?
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Types.h"
+
+#include <array>
+#include <cstddef>
+
+namespace Nerine
+{
+
+constexpr u64 HASH_SEED = 0xcbf29ce484222325ull;
+
+/*
+ * 64-bit FNV-1a. Not meant for hash tables on hot paths, but good enough to content address
+ * asset data.
+ */
+inline u64 HashBytes(const void* data, size_t size, u64 seed = HASH_SEED)
+{
+    const auto* bytes = static_cast<const u8*>(data);
+
+    u64 hash = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+template <typename T> inline u64 HashValue(const T& value, u64 seed = HASH_SEED)
+{
+    return HashBytes(&value, sizeof(T), seed);
+}
+
+inline u64 HashCombine(u64 seed, u64 hash)
+{
+    return seed ^ (hash + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+inline constexpr std::array<u32, 256> CRC32_TABLE = []() {
+    std::array<u32, 256> table{};
+    for (u32 i = 0; i < 256; i++)
+    {
+        u32 crc = i;
+        for (u32 bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320u : crc >> 1;
+        table[i] = crc;
+    }
+    return table;
+}();
+
+/*
+ * CRC-32 (IEEE, the zlib one) for detecting corrupted file data. Pass the previous result as crc
+ * to continue a checksum over several buffers.
+ */
+inline u32 Crc32(const void* data, size_t size, u32 crc = 0)
+{
+    const auto* bytes = static_cast<const u8*>(data);
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = CRC32_TABLE[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+} // namespace Nerine
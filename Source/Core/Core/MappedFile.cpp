@@ -0,0 +1,173 @@
+#include "MappedFile.h"
+
+#include "Logger.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Nerine
+{
+
+MappedFile::MappedFile(const std::string& fileName)
+{
+    Open(fileName);
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    Swap(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        Swap(other);
+    }
+
+    return *this;
+}
+
+void MappedFile::Swap(MappedFile& other) noexcept
+{
+    std::swap(m_Data, other.m_Data);
+    std::swap(m_Size, other.m_Size);
+
+#ifdef _WIN32
+    std::swap(m_FileHandle, other.m_FileHandle);
+    std::swap(m_MappingHandle, other.m_MappingHandle);
+#endif
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& fileName)
+{
+    Close();
+
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        LOG_ERROR("MappedFile: failed to open ", fileName);
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        LOG_ERROR("MappedFile: file ", fileName, " is empty");
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        LOG_ERROR("MappedFile: failed to create file mapping for ", fileName);
+        CloseHandle(file);
+        return false;
+    }
+
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr)
+    {
+        LOG_ERROR("MappedFile: failed to map ", fileName);
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_Data = static_cast<const u8*>(data);
+    m_Size = static_cast<size_t>(fileSize.QuadPart);
+    m_FileHandle = file;
+    m_MappingHandle = mapping;
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_Data != nullptr)
+        UnmapViewOfFile(m_Data);
+    if (m_MappingHandle != nullptr)
+        CloseHandle(m_MappingHandle);
+    if (m_FileHandle != nullptr)
+        CloseHandle(m_FileHandle);
+
+    m_Data = nullptr;
+    m_Size = 0;
+    m_FileHandle = nullptr;
+    m_MappingHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& fileName)
+{
+    Close();
+
+    const int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        LOG_ERROR("MappedFile: failed to open ", fileName);
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        LOG_ERROR("MappedFile: file ", fileName, " is empty");
+        close(fd);
+        return false;
+    }
+
+    const auto size = static_cast<size_t>(fileStat.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        LOG_ERROR("MappedFile: failed to map ", fileName);
+        return false;
+    }
+
+    // Mesh/scene files are consumed front to back, let the kernel read ahead aggressively.
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    m_Data = static_cast<const u8*>(data);
+    m_Size = size;
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_Data != nullptr)
+        munmap(const_cast<u8*>(m_Data), m_Size);
+
+    m_Data = nullptr;
+    m_Size = 0;
+}
+
+#endif
+
+} // namespace Nerine
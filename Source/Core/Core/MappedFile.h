@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+
+#include "Types.h"
+
+namespace Nerine
+{
+
+/*
+ * Read-only memory mapping of a whole file.
+ */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& fileName);
+    ~MappedFile();
+
+    NON_COPYABLE(MappedFile);
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool Open(const std::string& fileName);
+    void Close();
+
+    [[nodiscard]] bool IsOpen() const
+    {
+        return m_Data != nullptr;
+    }
+
+    [[nodiscard]] const u8* GetData() const
+    {
+        return m_Data;
+    }
+
+    [[nodiscard]] size_t GetSize() const
+    {
+        return m_Size;
+    }
+
+private:
+    void Swap(MappedFile& other) noexcept;
+
+    const u8* m_Data{nullptr};
+    size_t m_Size{0};
+
+#ifdef _WIN32
+    void* m_FileHandle{nullptr};
+    void* m_MappingHandle{nullptr};
+#endif
+};
+
+} // namespace Nerine
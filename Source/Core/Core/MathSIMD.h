@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Types.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define NERINE_SIMD_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace Nerine
+{
+
+/*
+ * a * b for column major 4x4 matrices. The SSE path keeps the operation order of glm's scalar
+ * product, ((a0 * b.x + a1 * b.y) + a2 * b.z) + a3 * b.w per column without fused multiply-adds,
+ * so both paths give bit identical results.
+ */
+inline void MultiplyMat4(const mat4& a, const mat4& b, mat4& result)
+{
+#ifdef NERINE_SIMD_SSE
+    const float* pa = &a[0][0];
+    const float* pb = &b[0][0];
+    float* pr = &result[0][0];
+
+    const __m128 a0 = _mm_loadu_ps(pa);
+    const __m128 a1 = _mm_loadu_ps(pa + 4);
+    const __m128 a2 = _mm_loadu_ps(pa + 8);
+    const __m128 a3 = _mm_loadu_ps(pa + 12);
+
+    for (u32 c = 0; c < 4; c++)
+    {
+        const __m128 column = _mm_loadu_ps(pb + c * 4);
+
+        __m128 sum = _mm_mul_ps(a0, _mm_shuffle_ps(column, column, _MM_SHUFFLE(0, 0, 0, 0)));
+        sum = _mm_add_ps(sum,
+                         _mm_mul_ps(a1, _mm_shuffle_ps(column, column, _MM_SHUFFLE(1, 1, 1, 1))));
+        sum = _mm_add_ps(sum,
+                         _mm_mul_ps(a2, _mm_shuffle_ps(column, column, _MM_SHUFFLE(2, 2, 2, 2))));
+        sum = _mm_add_ps(sum,
+                         _mm_mul_ps(a3, _mm_shuffle_ps(column, column, _MM_SHUFFLE(3, 3, 3, 3))));
+
+        _mm_storeu_ps(pr + c * 4, sum);
+    }
+#else
+    result = a * b;
+#endif
+}
+
+/*
+ * a * b for affine matrices, i.e. with a bottom row of (0, 0, 0, 1). The bottom row of b is not
+ * read, the products with its zeros are skipped.
+ */
+inline void MultiplyAffine(const mat4& a, const mat4& b, mat4& result)
+{
+#ifdef NERINE_SIMD_SSE
+    const float* pa = &a[0][0];
+    const float* pb = &b[0][0];
+    float* pr = &result[0][0];
+
+    const __m128 a0 = _mm_loadu_ps(pa);
+    const __m128 a1 = _mm_loadu_ps(pa + 4);
+    const __m128 a2 = _mm_loadu_ps(pa + 8);
+    const __m128 a3 = _mm_loadu_ps(pa + 12);
+
+    for (u32 c = 0; c < 4; c++)
+    {
+        const __m128 column = _mm_loadu_ps(pb + c * 4);
+
+        __m128 sum = _mm_mul_ps(a0, _mm_shuffle_ps(column, column, _MM_SHUFFLE(0, 0, 0, 0)));
+        sum = _mm_add_ps(sum,
+                         _mm_mul_ps(a1, _mm_shuffle_ps(column, column, _MM_SHUFFLE(1, 1, 1, 1))));
+        sum = _mm_add_ps(sum,
+                         _mm_mul_ps(a2, _mm_shuffle_ps(column, column, _MM_SHUFFLE(2, 2, 2, 2))));
+        if (c == 3)
+            sum = _mm_add_ps(sum, a3);
+
+        _mm_storeu_ps(pr + c * 4, sum);
+    }
+#else
+    for (u32 c = 0; c < 3; c++)
+        result[c] = a[0] * b[c].x + a[1] * b[c].y + a[2] * b[c].z;
+    result[3] = a[0] * b[3].x + a[1] * b[3].y + a[2] * b[3].z + a[3];
+#endif
+}
+
+/*
+ * Affine matrix of translation * rotation * scale, with a unit length rotation.
+ */
+inline void ComposeAffine(const vec3& translation, const quat& rotation, const vec3& scale,
+                          mat4& result)
+{
+    const mat3 r = glm::mat3_cast(rotation);
+
+    result[0] = vec4(r[0] * scale.x, 0.0f);
+    result[1] = vec4(r[1] * scale.y, 0.0f);
+    result[2] = vec4(r[2] * scale.z, 0.0f);
+    result[3] = vec4(translation, 1.0f);
+}
+
+} // namespace Nerine
@@ -261,6 +261,11 @@ public:
         return result;
     }
 
+    [[nodiscard]] u64 GetRefCount() const
+    {
+        return m_RefCount;
+    }
+
 private:
     std::atomic<u64> m_RefCount{1};
 };
@@ -0,0 +1,114 @@
+#include "StringTable.h"
+
+#include "Hash.h"
+
+#include <algorithm>
+
+namespace Nerine
+{
+
+namespace
+{
+
+constexpr size_t MIN_SLOT_COUNT = 64;
+
+} // namespace
+
+u32 StringTable::Intern(std::string_view str)
+{
+    const u64 hash = HashBytes(str.data(), str.size());
+
+    // Keep the load factor at or below 1/2.
+    if ((m_Hashes.size() + 1) * 2 > m_Slots.size())
+        Rehash(std::max(MIN_SLOT_COUNT, m_Slots.size() * 2));
+
+    const size_t slot = FindSlot(str, hash);
+    if (m_Slots[slot] != INVALID_STRING_ID)
+        return m_Slots[slot];
+
+    const u32 id = GetCount();
+    m_Blob.insert(m_Blob.end(), str.begin(), str.end());
+    m_Blob.push_back('\0');
+    m_Offsets.push_back((u32)m_Blob.size());
+    m_Hashes.push_back(hash);
+    m_Slots[slot] = id;
+
+    return id;
+}
+
+u32 StringTable::Find(std::string_view str) const
+{
+    if (m_Slots.empty())
+        return INVALID_STRING_ID;
+
+    return m_Slots[FindSlot(str, HashBytes(str.data(), str.size()))];
+}
+
+bool StringTable::Assign(std::vector<char> blob)
+{
+    Clear();
+
+    if (!blob.empty() && blob.back() != '\0')
+        return false;
+
+    size_t start = 0;
+    for (size_t i = 0; i < blob.size(); i++)
+    {
+        if (blob[i] != '\0')
+            continue;
+
+        // Ids are the string positions in the blob, a duplicate would shift them.
+        const u32 expectedId = GetCount();
+        if (Intern(std::string_view(&blob[start], i - start)) != expectedId)
+        {
+            Clear();
+            return false;
+        }
+        start = i + 1;
+    }
+
+    return true;
+}
+
+void StringTable::Clear()
+{
+    m_Blob.clear();
+    m_Offsets = {0};
+    m_Hashes.clear();
+    m_Slots.clear();
+}
+
+void StringTable::Rehash(size_t slotCount)
+{
+    m_Slots.assign(slotCount, INVALID_STRING_ID);
+
+    const size_t mask = slotCount - 1;
+    for (u32 id = 0; id < m_Hashes.size(); id++)
+    {
+        size_t slot = m_Hashes[id] & mask;
+        while (m_Slots[slot] != INVALID_STRING_ID)
+            slot = (slot + 1) & mask;
+
+        m_Slots[slot] = id;
+    }
+}
+
+size_t StringTable::FindSlot(std::string_view str, u64 hash) const
+{
+    const size_t mask = m_Slots.size() - 1;
+
+    // Linear probing, ends on the matching string or on an empty slot.
+    size_t slot = hash & mask;
+    while (m_Slots[slot] != INVALID_STRING_ID)
+    {
+        const u32 id = m_Slots[slot];
+        if (m_Hashes[id] == hash && Get(id) == str)
+            break;
+
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+} // namespace Nerine
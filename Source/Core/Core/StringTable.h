@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "Types.h"
+
+namespace Nerine
+{
+
+constexpr u32 INVALID_STRING_ID = u32(-1);
+
+/*
+ * Interned strings with dense 32-bit ids. Every distinct string is stored once, null terminated,
+ * in one contiguous blob, lookups by content go through an open addressing hash table.
+ */
+class StringTable
+{
+public:
+    /*
+     * Returns the id of the string, adding it if it is not in the table yet.
+     */
+    u32 Intern(std::string_view str);
+
+    /*
+     * Returns the id of the string or INVALID_STRING_ID.
+     */
+    [[nodiscard]] u32 Find(std::string_view str) const;
+
+    [[nodiscard]] std::string_view Get(u32 id) const
+    {
+        return std::string_view(&m_Blob[m_Offsets[id]], m_Offsets[id + 1] - m_Offsets[id] - 1);
+    }
+
+    [[nodiscard]] u32 GetCount() const
+    {
+        return (u32)m_Offsets.size() - 1;
+    }
+
+    [[nodiscard]] bool IsEmpty() const
+    {
+        return GetCount() == 0;
+    }
+
+    /*
+     * All strings back to back, each followed by a null terminator, in id order.
+     */
+    [[nodiscard]] const std::vector<char>& GetBlob() const
+    {
+        return m_Blob;
+    }
+
+    /*
+     * Replaces the contents with the strings of a blob laid out like GetBlob(), the n-th string
+     * gets id n. Returns false and leaves the table empty if the blob is not null terminated or
+     * holds a string twice.
+     */
+    bool Assign(std::vector<char> blob);
+
+    void Clear();
+
+private:
+    void Rehash(size_t slotCount);
+    [[nodiscard]] size_t FindSlot(std::string_view str, u64 hash) const;
+
+    std::vector<char> m_Blob;
+
+    // Start of every string in the blob, followed by the blob size.
+    std::vector<u32> m_Offsets{0};
+    std::vector<u64> m_Hashes;
+
+    // String ids, INVALID_STRING_ID for empty slots. Size is a power of two.
+    std::vector<u32> m_Slots;
+};
+
+} // namespace Nerine
@@ -24,6 +24,7 @@ using mat4 = glm::mat4;
 using vec2 = glm::vec2;
 using vec3 = glm::vec3;
 using vec4 = glm::vec4;
+using quat = glm::quat;
 using ivec2 = glm::ivec2;
 
 #define NON_COPYABLE(cls)                                                                          \
@@ -5,8 +5,6 @@
 namespace Nerine
 {
 
-using quat = glm::quat;
-
 class CameraController
 {
 public:
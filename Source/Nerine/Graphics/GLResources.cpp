@@ -1,6 +1,7 @@
 #include "GLResources.h"
 
 #include "RenderUtils.h"
+#include "TextureCache.h"
 
 #include <Core/Logger.h>
 
@@ -104,7 +105,7 @@ BufferHandle CreateBuffer(GLsizeiptr size, const void* data, GLbitfield flags)
 
 TextureHandle CreateTexture(GLenum type, const std::string& fileName, GLenum clamp)
 {
-    return TextureHandle::Create(new GLTexture(type, fileName, clamp));
+    return TextureCache::GetInstance().Get(type, fileName, clamp);
 }
 
 TextureHandle CreateTexture(GLenum type, u32 width, u32 height, GLenum internalFormat)
@@ -455,6 +456,11 @@ GLTexture::GLTexture(GLenum type, const std::string& fileName, GLenum clamp)
     Load(type, fileName, clamp);
 }
 
+GLTexture::GLTexture(const TextureImage2D& image, GLenum clamp)
+{
+    Upload2D(image, clamp);
+}
+
 GLTexture::~GLTexture()
 {
     if (m_Handle != 0)
@@ -497,8 +503,119 @@ void GLTexture::Write2D(u32 width, u32 height, const void* data)
     glMakeTextureHandleResidentARB(m_HandleBindless);
 }
 
+TextureImage2D DecodeTexture2D(const std::string& fileName)
+{
+    TextureImage2D image;
+
+    if (fileName.ends_with(".ktx"))
+    {
+        gli::texture gliTex = gli::load_ktx(fileName);
+        if (gliTex.empty())
+        {
+            LOG_ERROR("Failed to load KTX file: ", fileName);
+            return image;
+        }
+
+        gli::gl GL(gli::gl::PROFILE_KTX);
+        gli::gl::format const format = GL.translate(gliTex.format(), gliTex.swizzles());
+        glm::tvec3<GLsizei> extent(gliTex.extent(0));
+
+        image.width = extent.x;
+        image.height = extent.y;
+        image.internalFormat = format.Internal;
+        image.format = format.External;
+        image.type = format.Type;
+        image.compressed = gli::is_compressed(gliTex.format());
+        image.grayscale = gli::component_count(gliTex.format()) == 1;
+
+        image.levelOffsets.push_back(0);
+        for (size_t level = 0; level < gliTex.levels(); level++)
+        {
+            const auto* levelData = static_cast<const u8*>(gliTex.data(0, 0, level));
+            image.data.insert(image.data.end(), levelData, levelData + gliTex.size(level));
+            image.levelOffsets.push_back(image.data.size());
+        }
+    }
+    else
+    {
+        int w = 0;
+        int h = 0;
+        u8* data = stbi_load(fileName.c_str(), &w, &h, nullptr, STBI_rgb_alpha);
+        if (!data)
+        {
+            LOG_ERROR("Failed to load image file: ", fileName);
+            return image;
+        }
+
+        image.width = w;
+        image.height = h;
+        image.data.assign(data, data + (size_t)w * h * 4);
+        image.levelOffsets = {0, image.data.size()};
+        stbi_image_free((void*)data);
+    }
+
+    return image;
+}
+
+void GLTexture::Upload2D(const TextureImage2D& image, GLenum clamp)
+{
+    if (!image.IsValid())
+        return;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_Handle);
+    glTextureParameteri(m_Handle, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(m_Handle, GL_TEXTURE_WRAP_S, clamp);
+    glTextureParameteri(m_Handle, GL_TEXTURE_WRAP_T, clamp);
+
+    // Files with a precomputed mip chain are uploaded as is, compressed data cannot be mipmapped
+    // at runtime.
+    const int numLevels = static_cast<int>(image.GetLevelCount());
+    const bool generateMipMaps = numLevels == 1 && !image.compressed;
+    const int numMipMaps
+        = generateMipMaps ? GetNumMipMapLevels2D(image.width, image.height) : numLevels;
+
+    glTextureStorage2D(m_Handle, numMipMaps, image.internalFormat, image.width, image.height);
+    for (int level = 0; level < numLevels; level++)
+    {
+        const GLsizei w = std::max<GLsizei>(image.width >> level, 1);
+        const GLsizei h = std::max<GLsizei>(image.height >> level, 1);
+        const u8* data = image.data.data() + image.levelOffsets[level];
+        const auto size = static_cast<GLsizei>(image.levelOffsets[level + 1]
+                                               - image.levelOffsets[level]);
+
+        if (image.compressed)
+            glCompressedTextureSubImage2D(m_Handle, level, 0, 0, w, h, image.internalFormat, size,
+                                          data);
+        else
+            glTextureSubImage2D(m_Handle, level, 0, 0, w, h, image.format, image.type, data);
+    }
+
+    if (image.grayscale)
+    {
+        const GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+        glTextureParameteriv(m_Handle, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+
+    if (generateMipMaps)
+        glGenerateTextureMipmap(m_Handle);
+    glTextureParameteri(m_Handle, GL_TEXTURE_MAX_LEVEL, numMipMaps - 1);
+    glTextureParameteri(m_Handle, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(m_Handle, GL_TEXTURE_MAX_ANISOTROPY, 16);
+
+    m_HandleBindless = glGetTextureHandleARB(m_Handle);
+    glMakeTextureHandleResidentARB(m_HandleBindless);
+}
+
 void GLTexture::Load(GLenum type, const std::string& fileName, GLenum clamp)
 {
+    if (type == GL_TEXTURE_2D)
+    {
+        Upload2D(DecodeTexture2D(fileName), clamp);
+        return;
+    }
+
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
     glCreateTextures(type, 1, &m_Handle);
@@ -510,46 +627,9 @@ void GLTexture::Load(GLenum type, const std::string& fileName, GLenum clamp)
 
     int w = 0;
     int h = 0;
-    int numMipMaps = 0;
 
     switch (type)
     {
-    case GL_TEXTURE_2D: {
-        if (fileName.ends_with(".ktx"))
-        {
-            gli::texture gliTex = gli::load_ktx(fileName);
-            gli::gl GL(gli::gl::PROFILE_KTX);
-            gli::gl::format const format = GL.translate(gliTex.format(), gliTex.swizzles());
-            glm::tvec3<GLsizei> extent(gliTex.extent(0));
-            w = extent.x;
-            h = extent.y;
-            numMipMaps = GetNumMipMapLevels2D(w, h);
-            glTextureStorage2D(m_Handle, numMipMaps, format.Internal, w, h);
-            glTextureSubImage2D(m_Handle, 0, 0, 0, w, h, format.External, format.Type,
-                                gliTex.data(0, 0, 0));
-        }
-        else
-        {
-            u8* data = stbi_load(fileName.c_str(), &w, &h, nullptr, STBI_rgb_alpha);
-            if (!data)
-            {
-                LOG_ERROR("Failed to load image file: ", fileName);
-                Destroy();
-                return;
-            }
-
-            numMipMaps = GetNumMipMapLevels2D(w, h);
-            glTextureStorage2D(m_Handle, numMipMaps, GL_RGBA8, w, h);
-            glTextureSubImage2D(m_Handle, 0, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, data);
-            stbi_image_free((void*)data);
-        }
-
-        glGenerateTextureMipmap(m_Handle);
-        glTextureParameteri(m_Handle, GL_TEXTURE_MAX_LEVEL, numMipMaps - 1);
-        glTextureParameteri(m_Handle, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTextureParameteri(m_Handle, GL_TEXTURE_MAX_ANISOTROPY, 16);
-        break;
-    }
     case GL_TEXTURE_CUBE_MAP: {
         int comp = 0;
         const float* data = stbi_loadf(fileName.c_str(), &w, &h, &comp, 3);
@@ -30,6 +30,43 @@ using BufferHandle = RefCountPtr<GLBuffer>;
 
 BufferHandle CreateBuffer(GLsizeiptr size, const void* data, GLbitfield flags);
 
+/*
+ * 2D texture decoded on the CPU. Decoding does not touch GL and can run on any thread.
+ */
+struct TextureImage2D
+{
+    u32 width{0};
+    u32 height{0};
+
+    GLenum internalFormat{GL_RGBA8};
+    // External format and type of uncompressed data.
+    GLenum format{GL_RGBA};
+    GLenum type{GL_UNSIGNED_BYTE};
+    bool compressed{false};
+    // Single channel data that is sampled as grayscale.
+    bool grayscale{false};
+
+    // Stored levels back to back, levelOffsets has one extra entry with the total size. Images
+    // with a single uncompressed level get their mips generated on upload.
+    std::vector<u8> data;
+    std::vector<size_t> levelOffsets;
+
+    [[nodiscard]] bool IsValid() const
+    {
+        return !levelOffsets.empty();
+    }
+
+    [[nodiscard]] u32 GetLevelCount() const
+    {
+        return levelOffsets.empty() ? 0 : (u32)levelOffsets.size() - 1;
+    }
+};
+
+/*
+ * Decodes a KTX file with all its levels, or any other image format to RGBA8.
+ */
+TextureImage2D DecodeTexture2D(const std::string& fileName);
+
 class GLTexture : public RefCountResource<IResource>
 {
 public:
@@ -39,6 +76,7 @@ public:
 
     GLTexture(GLenum type, const std::string& fileName, GLenum clamp = GL_REPEAT);
     GLTexture(u32 width, u32 height, const void* data);
+    explicit GLTexture(const TextureImage2D& image, GLenum clamp = GL_REPEAT);
 
     explicit GLTexture(u32 handle) : m_Handle(handle){};
 
@@ -49,6 +87,7 @@ public:
     void Write2D(u32 width, u32 height, const void* data);
 
     void Load(GLenum type, const std::string& fileName, GLenum clamp = GL_REPEAT);
+    void Upload2D(const TextureImage2D& image, GLenum clamp = GL_REPEAT);
 
     void Destroy();
 
@@ -1,8 +1,11 @@
 #include "RenderScene.h"
 
+#include "TextureCache.h"
+
 #include <Core/Logger.h>
 
-#include <unordered_map>
+#include <algorithm>
+#include <cstddef>
 
 namespace Nerine
 {
@@ -18,6 +21,30 @@ GLuint64 GetTextureHandleBindless(u64 index, const std::vector<TextureHandle>& t
     return textures[index]->m_HandleBindless;
 }
 
+// Changed elements at most this far apart share one upload, a few unchanged elements cost less
+// than another buffer update call.
+constexpr u32 MAX_UPLOAD_GAP = 16;
+
+/*
+ * Uploads the elements at the sorted indices, nearby indices are coalesced into one range.
+ */
+template <typename T>
+void UploadElements(const BufferHandle& buffer, const std::vector<T>& elements,
+                    const std::vector<u32>& indices)
+{
+    size_t i = 0;
+    while (i < indices.size())
+    {
+        const u32 first = indices[i];
+        u32 last = first;
+        while (++i < indices.size() && indices[i] - last <= MAX_UPLOAD_GAP)
+            last = indices[i];
+
+        glNamedBufferSubData(buffer->m_Handle, first * sizeof(T), (last - first + 1) * sizeof(T),
+                             &elements[first]);
+    }
+}
+
 } // namespace
 
 GLSceneData::GLSceneData(const std::string& meshFile, const std::string& sceneFile,
@@ -35,18 +62,9 @@ void GLSceneData::Load(const std::string& meshFile, const std::string& sceneFile
     std::vector<std::string> textureFiles;
     LoadMaterials(materialFile, materials, textureFiles);
 
-    std::unordered_map<std::string, u32> fnMap;
-
-    for (const auto& file : textureFiles)
-    {
-        materialTextures.push_back(TextureHandle::Create(new GLTexture(GL_TEXTURE_2D, file)));
-        if (!fnMap.contains(file))
-        {
-            fnMap[file] = 0;
-        }
-    }
-
-    LOG_INFO("Unique files count: ", fnMap.size());
+    // Bindless handles only exist once every texture is uploaded, materials are patched below.
+    // Files referenced more than once share one texture.
+    materialTextures = TextureCache::GetInstance().Get2D(textureFiles);
 
     int idx = 0;
     for (auto& material : materials)
@@ -63,6 +81,12 @@ void GLSceneData::Load(const std::string& meshFile, const std::string& sceneFile
 
         idx++;
     }
+
+    for (auto& shape : shapes)
+    {
+        if (materials[shape.materialIndex].flags & u32(MaterialFlags::TRANSPARENT))
+            shape.flags |= u32(DrawFlags::TRANSPARENT);
+    }
 }
 
 void GLSceneData::LoadSceneFile(const std::string& sceneFile)
@@ -74,20 +98,31 @@ void GLSceneData::LoadSceneFile(const std::string& sceneFile)
         return;
     }
 
-    for (const auto& c : scene.meshesMap)
+    for (u32 node = 0; node < scene.nodeMeshes.size(); node++)
     {
-        auto material = scene.materialsMap.find(c.first);
-        if (material != scene.materialsMap.end())
-        {
-            shapes.push_back(DrawData{.meshIndex = c.second,
-                                      .materialIndex = material->second,
-                                      .LOD = 0,
-                                      .indexOffset = meshData.meshes[c.second].indexOffset,
-                                      .vertexOffset = meshData.meshes[c.second].vertexOffset,
-                                      .transformIndex = c.first});
-        }
+        const u32 meshIndex = scene.nodeMeshes[node];
+        const u32 materialIndex = scene.nodeMaterials[node];
+        if (meshIndex == u32(-1) || materialIndex == u32(-1))
+            continue;
+
+        const auto& mesh = meshData.meshes[meshIndex];
+        const auto flags
+            = (mesh.indexFormat == IndexFormat::U16) ? DrawFlags::INDEX16 : DrawFlags::NONE;
+
+        shapes.push_back(DrawData{.meshIndex = meshIndex,
+                                  .materialIndex = materialIndex,
+                                  .LOD = 0,
+                                  .indexOffset = mesh.indexOffset,
+                                  .vertexOffset = mesh.vertexOffset,
+                                  .transformIndex = node,
+                                  .flags = u32(flags)});
     }
 
+    // GLMesh issues one multi draw per index type.
+    std::stable_partition(shapes.begin(), shapes.end(), [](const DrawData& shape) {
+        return !(shape.flags & u32(DrawFlags::INDEX16));
+    });
+
     MarkAsChanged(scene, 0);
     RecalculateGlobalTransforms(scene);
 }
@@ -143,10 +178,15 @@ void GLIndirectBuffer::SelectDrawCommands(
     const std::function<bool(const DrawElementsIndirectCommand&)>& predicate)
 {
     outputBuffer->m_DrawCommands.clear();
-    for (const auto& drawCommand : m_DrawCommands)
+    outputBuffer->m_NumDrawCommands32 = 0;
+    for (size_t i = 0; i < m_DrawCommands.size(); i++)
     {
-        if (predicate(drawCommand))
-            outputBuffer->m_DrawCommands.push_back(drawCommand);
+        if (!predicate(m_DrawCommands[i]))
+            continue;
+
+        outputBuffer->m_DrawCommands.push_back(m_DrawCommands[i]);
+        if (i < m_NumDrawCommands32)
+            outputBuffer->m_NumDrawCommands32++;
     }
     outputBuffer->UploadIndirectBuffer();
 }
@@ -157,15 +197,22 @@ IndirectBufferHandle CreateIndirectBuffer(size_t maxDrawCommands)
 }
 
 GLMesh::GLMesh(GLSceneData& sceneData)
-    : m_NumIndices(sceneData.meshHeader.indexDataSize / sizeof(u32)),
-      m_BufferIndices(
-          CreateBuffer(sceneData.meshHeader.indexDataSize, sceneData.meshData.indexData.data(), 0)),
-      m_BufferVertices(CreateBuffer(sceneData.meshHeader.vertexDataSize,
+    : m_NumIndices(
+        (u32)(sceneData.meshData.indexData.size() + sceneData.meshData.indexData16.size())),
+      m_FirstIndex16((u32)(sceneData.meshData.indexData.size_bytes() / sizeof(u16))),
+      m_BufferIndices(CreateBuffer(sceneData.meshData.indexData.size_bytes()
+                                       + sceneData.meshData.indexData16.size_bytes(),
+                                   nullptr, GL_DYNAMIC_STORAGE_BIT)),
+      m_BufferVertices(CreateBuffer(sceneData.meshData.vertexData.size_bytes(),
                                     sceneData.meshData.vertexData.data(), 0)),
       m_BufferMaterials(CreateBuffer(sizeof(MaterialDescription) * sceneData.materials.size(),
                                      sceneData.materials.data(), 0)),
       m_BufferModelMatrices(CreateBuffer(sizeof(glm::mat4) * sceneData.shapes.size(), nullptr,
                                          GL_DYNAMIC_STORAGE_BIT)),
+      m_BufferDrawData(CreateBuffer(sizeof(GPUDrawData) * sceneData.shapes.size(), nullptr,
+                                    GL_DYNAMIC_STORAGE_BIT)),
+      m_BufferBoundingBoxes(CreateBuffer(sizeof(BoundingBox) * sceneData.shapes.size(), nullptr,
+                                         GL_DYNAMIC_STORAGE_BIT)),
       m_BufferIndirect(CreateIndirectBuffer(sceneData.shapes.size()))
 {
     LoadSceneData(sceneData);
@@ -184,49 +231,162 @@ void GLMesh::LoadSceneData(GLSceneData& sceneData)
     // XXX: Need this? Strong reference needed?
     m_SceneData = &sceneData;
 
-    glCreateVertexArrays(1, &m_Vao);
-    glVertexArrayElementBuffer(m_Vao, m_BufferIndices->m_Handle);
-    glVertexArrayVertexBuffer(m_Vao, 0, m_BufferVertices->m_Handle, 0,
-                              sizeof(vec3) + sizeof(vec3) + sizeof(vec2));
+    // All meshes share one VAO, so the vertex format has to be the same for the whole file.
+    const auto vertexFormat = sceneData.meshData.meshes.empty()
+                                  ? VertexFormat::Float
+                                  : sceneData.meshData.meshes[0].vertexFormat;
+    for (const auto& mesh : sceneData.meshData.meshes)
+    {
+        if (mesh.vertexFormat != vertexFormat)
+        {
+            LOG_ERROR("GLMesh: meshes with different vertex formats are not supported");
+            break;
+        }
+    }
 
-    // Position.
-    glEnableVertexArrayAttrib(m_Vao, 0);
-    glVertexArrayAttribFormat(m_Vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
-    glVertexArrayAttribBinding(m_Vao, 0, 0);
+    // Both index pools share one element buffer.
+    const auto& indexData = sceneData.meshData.indexData;
+    const auto& indexData16 = sceneData.meshData.indexData16;
+    glNamedBufferSubData(m_BufferIndices->m_Handle, 0, indexData.size_bytes(), indexData.data());
+    glNamedBufferSubData(m_BufferIndices->m_Handle, indexData.size_bytes(),
+                         indexData16.size_bytes(), indexData16.data());
 
-    // UV.
-    glEnableVertexArrayAttrib(m_Vao, 1);
-    glVertexArrayAttribFormat(m_Vao, 1, 2, GL_FLOAT, GL_FALSE, sizeof(vec3));
-    glVertexArrayAttribBinding(m_Vao, 1, 0);
+    glCreateVertexArrays(1, &m_Vao);
+    glVertexArrayElementBuffer(m_Vao, m_BufferIndices->m_Handle);
 
-    // Normal.
-    glEnableVertexArrayAttrib(m_Vao, 2);
-    glVertexArrayAttribFormat(m_Vao, 2, 3, GL_FLOAT, GL_TRUE, sizeof(vec3) + sizeof(vec2));
-    glVertexArrayAttribBinding(m_Vao, 2, 0);
+    if (vertexFormat == VertexFormat::Quantized)
+    {
+        glVertexArrayVertexBuffer(m_Vao, 0, m_BufferVertices->m_Handle, 0,
+                                  sizeof(QuantizedVertex));
+
+        // Position, dequantized by the model matrix.
+        glEnableVertexArrayAttrib(m_Vao, 0);
+        glVertexArrayAttribFormat(m_Vao, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE,
+                                  offsetof(QuantizedVertex, position));
+        glVertexArrayAttribBinding(m_Vao, 0, 0);
+
+        // UV.
+        glEnableVertexArrayAttrib(m_Vao, 1);
+        glVertexArrayAttribFormat(m_Vao, 1, 2, GL_HALF_FLOAT, GL_FALSE,
+                                  offsetof(QuantizedVertex, uv));
+        glVertexArrayAttribBinding(m_Vao, 1, 0);
+
+        // Octahedral normal, attribute 2 stays disabled and reads as zero.
+        glEnableVertexArrayAttrib(m_Vao, 3);
+        glVertexArrayAttribFormat(m_Vao, 3, 2, GL_SHORT, GL_TRUE,
+                                  offsetof(QuantizedVertex, normal));
+        glVertexArrayAttribBinding(m_Vao, 3, 0);
+    }
+    else
+    {
+        glVertexArrayVertexBuffer(m_Vao, 0, m_BufferVertices->m_Handle, 0,
+                                  sizeof(vec3) + sizeof(vec3) + sizeof(vec2));
+
+        // Position.
+        glEnableVertexArrayAttrib(m_Vao, 0);
+        glVertexArrayAttribFormat(m_Vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribBinding(m_Vao, 0, 0);
+
+        // UV.
+        glEnableVertexArrayAttrib(m_Vao, 1);
+        glVertexArrayAttribFormat(m_Vao, 1, 2, GL_FLOAT, GL_FALSE, sizeof(vec3));
+        glVertexArrayAttribBinding(m_Vao, 1, 0);
+
+        // Normal.
+        glEnableVertexArrayAttrib(m_Vao, 2);
+        glVertexArrayAttribFormat(m_Vao, 2, 3, GL_FLOAT, GL_TRUE, sizeof(vec3) + sizeof(vec2));
+        glVertexArrayAttribBinding(m_Vao, 2, 0);
+    }
 
-    // Matrices to hold transform values,
-    std::vector<mat4> matrices(sceneData.shapes.size());
+    m_DrawData.resize(sceneData.shapes.size());
+    m_ModelMatrices.resize(sceneData.shapes.size());
+    m_WorldBoxes.resize(sceneData.shapes.size());
+    m_NodeFirstShape.assign(sceneData.scene.hierarchy.size(), u32(-1));
+    m_NextShape.assign(sceneData.shapes.size(), u32(-1));
 
     // Upload indirect draw commands.
+    m_BufferIndirect->m_NumDrawCommands32 = 0;
     for (size_t i = 0; i != sceneData.shapes.size(); i++)
     {
-        const u32 meshIdx = sceneData.shapes[i].meshIndex;
+        const auto& mesh = sceneData.meshData.meshes[sceneData.shapes[i].meshIndex];
         const u32 lod = sceneData.shapes[i].LOD;
+        if (mesh.indexFormat == IndexFormat::U32)
+            m_BufferIndirect->m_NumDrawCommands32++;
+
         m_BufferIndirect->m_DrawCommands[i] = {
-            .count = sceneData.meshData.meshes[meshIdx].GetLODIndicesCount(lod),
+            .count = mesh.GetLODIndicesCount(lod),
             .instanceCount = 1,
-            .firstIndex = sceneData.shapes[i].indexOffset,
+            .firstIndex = GetFirstIndex(mesh, lod),
             .baseVertex = sceneData.shapes[i].vertexOffset,
-            .baseInstance = sceneData.shapes[i].materialIndex + (u32(i) << 16),
+            .baseInstance = (u32)i,
+        };
+
+        m_DrawData[i] = {
+            .transformIndex = (u32)i,
+            .materialIndex = sceneData.shapes[i].materialIndex,
+            .LOD = lod,
+            .flags = sceneData.shapes[i].flags,
         };
 
-        matrices[i] = sceneData.scene.globalTransforms[sceneData.shapes[i].transformIndex];
+        UpdateShapeTransform((u32)i);
     }
     m_BufferIndirect->UploadIndirectBuffer();
 
-    // Upload transforms.
-    glNamedBufferSubData(m_BufferModelMatrices->m_Handle, 0, matrices.size() * sizeof(mat4),
-                         matrices.data());
+    // Walk backwards and push to the front so the shapes of a node end up in ascending order.
+    for (u32 i = (u32)sceneData.shapes.size(); i-- > 0;)
+    {
+        const u32 node = sceneData.shapes[i].transformIndex;
+        m_NextShape[i] = m_NodeFirstShape[node];
+        m_NodeFirstShape[node] = i;
+    }
+
+    // Upload transforms, bounding boxes and per draw data.
+    glNamedBufferSubData(m_BufferModelMatrices->m_Handle, 0, m_ModelMatrices.size() * sizeof(mat4),
+                         m_ModelMatrices.data());
+    glNamedBufferSubData(m_BufferBoundingBoxes->m_Handle, 0,
+                         m_WorldBoxes.size() * sizeof(BoundingBox), m_WorldBoxes.data());
+    UploadDrawData();
+
+    m_BVH.Build(m_WorldBoxes);
+    m_ShapeVisible.assign(m_WorldBoxes.size(), 1);
+}
+
+void GLMesh::UpdateTransforms(const std::vector<u32>& updatedNodes)
+{
+    m_UpdatedShapes.clear();
+    for (const u32 node : updatedNodes)
+    {
+        // Nodes added after loading have no shapes.
+        if (node >= m_NodeFirstShape.size())
+            continue;
+
+        for (u32 shape = m_NodeFirstShape[node]; shape != u32(-1); shape = m_NextShape[shape])
+        {
+            UpdateShapeTransform(shape);
+            m_UpdatedShapes.push_back(shape);
+        }
+    }
+
+    if (m_UpdatedShapes.empty())
+        return;
+
+    std::sort(m_UpdatedShapes.begin(), m_UpdatedShapes.end());
+    UploadElements(m_BufferModelMatrices, m_ModelMatrices, m_UpdatedShapes);
+    UploadElements(m_BufferBoundingBoxes, m_WorldBoxes, m_UpdatedShapes);
+    m_BVH.Refit(m_UpdatedShapes, m_WorldBoxes);
+}
+
+void GLMesh::UpdateShapeTransform(u32 shapeIndex)
+{
+    const auto& shape = m_SceneData->shapes[shapeIndex];
+    const auto& mesh = m_SceneData->meshData.meshes[shape.meshIndex];
+    const mat4& model = m_SceneData->scene.globalTransforms[shape.transformIndex];
+
+    // The dequantization transform only applies to vertices, mesh bounding boxes are in object
+    // space already.
+    m_ModelMatrices[shapeIndex] = model * GetVertexDequantizationTransform(mesh);
+    m_WorldBoxes[shapeIndex] = m_SceneData->meshData.boundingBoxes[shape.meshIndex];
+    m_WorldBoxes[shapeIndex].Transform(model);
 }
 
 void GLMesh::Draw(u32 numDrawCommands, IndirectBufferHandle indirectBuffer) const
@@ -235,11 +395,124 @@ void GLMesh::Draw(u32 numDrawCommands, IndirectBufferHandle indirectBuffer) cons
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BUFFER_INDEX_MATERIALS, m_BufferMaterials->m_Handle);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BUFFER_INDEX_MODEL_MATRICES,
                      m_BufferModelMatrices->m_Handle);
-    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, (indirectBuffer != nullptr) ? indirectBuffer->m_Handle
-                                                                      : m_BufferIndirect->m_Handle);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BUFFER_INDEX_DRAW_DATA, m_BufferDrawData->m_Handle);
+    const auto& buffer = (indirectBuffer != nullptr) ? indirectBuffer : m_BufferIndirect;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer->m_Handle);
+
+    const auto numDrawCommands32 = std::min<size_t>(numDrawCommands, buffer->m_NumDrawCommands32);
+    const auto numDrawCommands16 = numDrawCommands - numDrawCommands32;
+
+    if (numDrawCommands32 > 0)
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr,
+                                    (GLsizei)numDrawCommands32, 0);
+    if (numDrawCommands16 > 0)
+        glMultiDrawElementsIndirect(
+            GL_TRIANGLES, GL_UNSIGNED_SHORT,
+            (const void*)(numDrawCommands32 * sizeof(DrawElementsIndirectCommand)),
+            (GLsizei)numDrawCommands16, 0);
+}
+
+void GLMesh::SelectLODs(const vec3& cameraPos, float pixelsPerUnit, float maxPixelError)
+{
+    m_LODChangedShapes.clear();
+
+    for (u32 shapeIndex = 0; shapeIndex < m_SceneData->shapes.size(); shapeIndex++)
+    {
+        auto& shape = m_SceneData->shapes[shapeIndex];
+        const auto& mesh = m_SceneData->meshData.meshes[shape.meshIndex];
+        const auto& box = m_WorldBoxes[shapeIndex];
+
+        // Distance to the closest point of the box, 0 when the camera is inside it.
+        const float distance = glm::length(glm::clamp(cameraPos, box.min, box.max) - cameraPos);
+
+        const mat4& model = m_SceneData->scene.globalTransforms[shape.transformIndex];
+        const float scale = std::max({glm::length(vec3(model[0])), glm::length(vec3(model[1])),
+                                      glm::length(vec3(model[2]))});
+
+        // Projected error is error * scale * pixelsPerUnit / distance, LOD errors only grow.
+        u32 lod = 0;
+        while (lod + 1 < mesh.lodCount
+               && mesh.lodError[lod + 1] * scale * pixelsPerUnit <= maxPixelError * distance)
+            lod++;
+
+        shape.LOD = lod;
+        if (m_DrawData[shapeIndex].LOD != lod)
+        {
+            m_DrawData[shapeIndex].LOD = lod;
+            m_LODChangedShapes.push_back(shapeIndex);
+        }
+    }
+
+    UploadElements(m_BufferDrawData, m_DrawData, m_LODChangedShapes);
+}
+
+void GLMesh::ApplyLODs(IndirectBufferHandle indirectBuffer)
+{
+    // Commands of shapes that kept their LOD are up to date already.
+    if (m_LODChangedShapes.empty())
+        return;
 
-    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)numDrawCommands,
-                                0);
+    std::vector<u32> changedCommands;
+    auto& commands = indirectBuffer->m_DrawCommands;
+    for (u32 i = 0; i < commands.size(); i++)
+    {
+        auto& command = commands[i];
+        const auto& shape = m_SceneData->shapes[command.baseInstance];
+        const auto& mesh = m_SceneData->meshData.meshes[shape.meshIndex];
+
+        const u32 count = mesh.GetLODIndicesCount(shape.LOD);
+        const u32 firstIndex = GetFirstIndex(mesh, shape.LOD);
+        if (command.count != count || command.firstIndex != firstIndex)
+        {
+            command.count = count;
+            command.firstIndex = firstIndex;
+            changedCommands.push_back(i);
+        }
+    }
+
+    UploadElements(indirectBuffer->m_BufferIndirect, commands, changedCommands);
+}
+
+void GLMesh::SelectVisibleShapes(const vec4* frustumPlanes, const vec4* frustumCorners)
+{
+    m_BVH.QueryFrustum(frustumPlanes, frustumCorners, m_VisibleShapes);
+
+    std::fill(m_ShapeVisible.begin(), m_ShapeVisible.end(), 0u);
+    for (const u32 shape : m_VisibleShapes)
+        m_ShapeVisible[shape] = 1;
+}
+
+u32 GLMesh::ApplyVisibility(IndirectBufferHandle indirectBuffer, bool uploadAll)
+{
+    u32 numVisible = 0;
+    std::vector<u32> changedCommands;
+    auto& commands = indirectBuffer->m_DrawCommands;
+    for (u32 i = 0; i < commands.size(); i++)
+    {
+        auto& command = commands[i];
+        const u32 instanceCount = m_ShapeVisible[command.baseInstance];
+        numVisible += instanceCount;
+        if (uploadAll || command.instanceCount != instanceCount)
+        {
+            command.instanceCount = instanceCount;
+            changedCommands.push_back(i);
+        }
+    }
+
+    UploadElements(indirectBuffer->m_BufferIndirect, commands, changedCommands);
+    return numVisible;
+}
+
+void GLMesh::UploadDrawData()
+{
+    glNamedBufferSubData(m_BufferDrawData->m_Handle, 0, m_DrawData.size() * sizeof(GPUDrawData),
+                         m_DrawData.data());
+}
+
+u32 GLMesh::GetFirstIndex(const Mesh& mesh, u32 lod) const
+{
+    const u32 firstIndex = mesh.indexOffset + mesh.lodOffset[lod];
+    return (mesh.indexFormat == IndexFormat::U16) ? m_FirstIndex16 + firstIndex : firstIndex;
 }
 
 } // namespace Nerine
\ No newline at end of file
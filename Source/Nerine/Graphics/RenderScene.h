@@ -1,5 +1,6 @@
 #pragma once
 
+#include <RenderDescription/BVH.h>
 #include <RenderDescription/Material.h>
 #include <RenderDescription/Mesh.h>
 #include <RenderDescription/Scene.h>
@@ -14,6 +15,7 @@ namespace Nerine
 constexpr GLuint BUFFER_INDEX_PERFRAME_UNIFORMS = 0;
 constexpr GLuint BUFFER_INDEX_MODEL_MATRICES = 1;
 constexpr GLuint BUFFER_INDEX_MATERIALS = 2;
+constexpr GLuint BUFFER_INDEX_DRAW_DATA = 4;
 
 /*
  * Shader structure types.
@@ -95,6 +97,21 @@ struct GPUFXAAParams
 static_assert(sizeof(GPUSSAOParams) <= sizeof(GPUSceneData));
 static_assert(sizeof(GPUHDRParams) <= sizeof(GPUSceneData));
 
+/*
+ * Per draw data, indexed by the baseInstance of the draw command. gl_DrawID restarts for every
+ * multi draw and is not stable once commands are culled or split, baseInstance is.
+ */
+struct GPUDrawData
+{
+    // Index into the model matrix buffer. There is one matrix per draw, the dequantization
+    // transform of the mesh is folded into it.
+    u32 transformIndex;
+    u32 materialIndex;
+    u32 LOD;
+    // DrawFlags.
+    u32 flags;
+};
+
 // Transparency linked-list "node".
 struct GPUTransparentFragment
 {
@@ -133,11 +150,14 @@ public:
     std::vector<TextureHandle> materialTextures;
 
     MeshFileHeader meshHeader;
-    MeshData meshData;
+    // Mesh data is kept memory mapped, GLMesh uploads straight from the mapping.
+    MeshDataView meshData;
 
     Scene scene;
 
     std::vector<MaterialDescription> materials;
+
+    // Shapes using 32-bit indices come first, followed by the ones using 16-bit indices.
     std::vector<DrawData> shapes;
 };
 
@@ -172,6 +192,9 @@ public:
 
     std::vector<DrawElementsIndirectCommand> m_DrawCommands;
 
+    // The first m_NumDrawCommands32 commands draw with 32-bit indices, the rest with 16-bit ones.
+    size_t m_NumDrawCommands32{0};
+
     GLuint m_Handle;
 
     BufferHandle m_BufferIndirect;
@@ -195,13 +218,86 @@ public:
 
     void Draw(u32 numDrawCommands, IndirectBufferHandle indirectBuffer = nullptr) const;
 
+    /*
+     * Screen-space error LOD selection. Picks the coarsest LOD per shape whose simplification
+     * error, projected at the distance of the shape's world space bounding box, stays within
+     * maxPixelError pixels, and uploads the draw data of the shapes that changed LOD.
+     * pixelsPerUnit is the projected pixel size of a unit length at distance 1, i.e.
+     * proj[1][1] * viewportHeight / 2. Runs once per frame, ApplyLODs() then patches the draw
+     * commands of every indirect buffer.
+     */
+    void SelectLODs(const vec3& cameraPos, float pixelsPerUnit, float maxPixelError);
+
+    /*
+     * Rewrites count/firstIndex of the commands whose shape changed LOD in the last SelectLODs()
+     * and uploads only the changed commands.
+     */
+    void ApplyLODs(IndirectBufferHandle indirectBuffer);
+
+    /*
+     * CPU frustum culling of the shapes against m_BVH. Runs once per frame, ApplyVisibility() then
+     * sets the instance counts of every indirect buffer.
+     */
+    void SelectVisibleShapes(const vec4* frustumPlanes, const vec4* frustumCorners);
+
+    /*
+     * Sets instanceCount of the commands to the visibility of their shape from the last
+     * SelectVisibleShapes() and uploads the changed commands. uploadAll uploads every command,
+     * needed when the GPU wrote the instance counts since the last call. Returns the number of
+     * visible commands.
+     */
+    u32 ApplyVisibility(IndirectBufferHandle indirectBuffer, bool uploadAll);
+
+    u32 GetFirstIndex(const Mesh& mesh, u32 lod) const;
+
+    void UploadDrawData();
+
+    /*
+     * Recomputes the model matrices and world space bounding boxes of the shapes of the given
+     * nodes, usually the ones updated by RecalculateGlobalTransforms, and uploads the changed
+     * ranges. Nearby changes are coalesced into one upload.
+     */
+    void UpdateTransforms(const std::vector<u32>& updatedNodes);
+
+    void UpdateShapeTransform(u32 shapeIndex);
+
     GLuint m_Vao{0};
     u32 m_NumIndices;
 
+    // The element buffer holds the 32-bit index pool followed by the 16-bit one, firstIndex of
+    // 16-bit draws is offset by the size of the 32-bit pool.
+    u32 m_FirstIndex16{0};
+
     BufferHandle m_BufferIndices;
     BufferHandle m_BufferVertices;
     BufferHandle m_BufferMaterials;
     BufferHandle m_BufferModelMatrices;
+    BufferHandle m_BufferDrawData;
+    BufferHandle m_BufferBoundingBoxes;
+
+    // CPU copies of m_BufferDrawData, m_BufferModelMatrices and m_BufferBoundingBoxes, one entry
+    // per shape.
+    std::vector<GPUDrawData> m_DrawData;
+    std::vector<mat4> m_ModelMatrices;
+    std::vector<BoundingBox> m_WorldBoxes;
+
+    // Shapes of every node: first shape per node, then the next shape of the same node per shape,
+    // both u32(-1) terminated.
+    std::vector<u32> m_NodeFirstShape;
+    std::vector<u32> m_NextShape;
+
+    // Shapes changed by the last UpdateTransforms(), in ascending order.
+    std::vector<u32> m_UpdatedShapes;
+
+    // Shapes that changed LOD in the last SelectLODs(), in ascending order.
+    std::vector<u32> m_LODChangedShapes;
+
+    // Hierarchy over m_WorldBoxes, items are shape indices. Refit by UpdateTransforms().
+    BVH m_BVH;
+
+    // Result of the last SelectVisibleShapes(), the visible shapes and a 0/1 flag per shape.
+    std::vector<u32> m_VisibleShapes;
+    std::vector<u32> m_ShapeVisible;
 
     IndirectBufferHandle m_BufferIndirect;
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <RenderDescription/BoundingBox.h>
+#include <RenderDescription/Frustum.h>
 
 #include <Core/Types.h>
 
@@ -134,90 +135,6 @@ private:
 Bitmap ConvertEquirectangularMapToVerticalCross(const Bitmap& bitmap);
 Bitmap ConvertVerticalCrossToCubeMapFaces(const Bitmap& bitmap);
 
-/*
- * Frustum culling calculations.
- */
-inline void GetFrustumPlanes(mat4 mvp, vec4* planes)
-{
-    mvp = glm::transpose(mvp);
-    planes[0] = vec4(mvp[3] + mvp[0]); // left
-    planes[1] = vec4(mvp[3] - mvp[0]); // right
-    planes[2] = vec4(mvp[3] + mvp[1]); // bottom
-    planes[3] = vec4(mvp[3] - mvp[1]); // top
-    planes[4] = vec4(mvp[3] + mvp[2]); // near
-    planes[5] = vec4(mvp[3] - mvp[2]); // far
-}
-
-inline void GetFrustumCorners(mat4 mvp, vec4* points)
-{
-    const vec4 corners[]
-        = {vec4(-1, -1, -1, 1), vec4(1, -1, -1, 1), vec4(1, 1, -1, 1), vec4(-1, 1, -1, 1),
-           vec4(-1, -1, 1, 1),  vec4(1, -1, 1, 1),  vec4(1, 1, 1, 1),  vec4(-1, 1, 1, 1)};
-
-    const mat4 invMVP = glm::inverse(mvp);
-
-    for (int i = 0; i != 8; i++)
-    {
-        const vec4 q = invMVP * corners[i];
-        points[i] = q / q.w;
-    }
-}
-
-inline bool IsBoxInFrustum(vec4* frustumPlanes, vec4* frustumCorners, const BoundingBox& box)
-{
-    using glm::dot;
-
-    for (int i = 0; i < 6; i++)
-    {
-        int r = 0;
-        r += (dot(frustumPlanes[i], vec4(box.min.x, box.min.y, box.min.z, 1.0f)) < 0.0) ? 1 : 0;
-        r += (dot(frustumPlanes[i], vec4(box.max.x, box.min.y, box.min.z, 1.0f)) < 0.0) ? 1 : 0;
-        r += (dot(frustumPlanes[i], vec4(box.min.x, box.max.y, box.min.z, 1.0f)) < 0.0) ? 1 : 0;
-        r += (dot(frustumPlanes[i], vec4(box.max.x, box.max.y, box.min.z, 1.0f)) < 0.0) ? 1 : 0;
-        r += (dot(frustumPlanes[i], vec4(box.min.x, box.min.y, box.max.z, 1.0f)) < 0.0) ? 1 : 0;
-        r += (dot(frustumPlanes[i], vec4(box.max.x, box.min.y, box.max.z, 1.0f)) < 0.0) ? 1 : 0;
-        r += (dot(frustumPlanes[i], vec4(box.min.x, box.max.y, box.max.z, 1.0f)) < 0.0) ? 1 : 0;
-        r += (dot(frustumPlanes[i], vec4(box.max.x, box.max.y, box.max.z, 1.0f)) < 0.0) ? 1 : 0;
-        if (r == 8)
-            return false;
-    }
-
-    // Check if frustum is outside or inside box.
-    int r = 0;
-    r = 0;
-    for (int i = 0; i < 8; i++)
-        r += ((frustumCorners[i].x > box.max.x) ? 1 : 0);
-    if (r == 8)
-        return false;
-    r = 0;
-    for (int i = 0; i < 8; i++)
-        r += ((frustumCorners[i].x < box.min.x) ? 1 : 0);
-    if (r == 8)
-        return false;
-    r = 0;
-    for (int i = 0; i < 8; i++)
-        r += ((frustumCorners[i].y > box.max.y) ? 1 : 0);
-    if (r == 8)
-        return false;
-    r = 0;
-    for (int i = 0; i < 8; i++)
-        r += ((frustumCorners[i].y < box.min.y) ? 1 : 0);
-    if (r == 8)
-        return false;
-    r = 0;
-    for (int i = 0; i < 8; i++)
-        r += ((frustumCorners[i].z > box.max.z) ? 1 : 0);
-    if (r == 8)
-        return false;
-    r = 0;
-    for (int i = 0; i < 8; i++)
-        r += ((frustumCorners[i].z < box.min.z) ? 1 : 0);
-    if (r == 8)
-        return false;
-
-    return true;
-}
-
 /*
  * Obtain one bounding box from all existing boxes.
  */
@@ -0,0 +1,106 @@
+#include "TextureCache.h"
+
+#include "TextureLoader.h"
+
+#include <Core/Logger.h>
+
+#include <filesystem>
+#include <system_error>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+namespace Nerine
+{
+
+TextureCache& TextureCache::GetInstance()
+{
+    static TextureCache cache;
+    return cache;
+}
+
+std::string TextureCache::GetKey(GLenum type, const std::string& fileName, GLenum clamp)
+{
+    // Different spellings of the same path share the entry.
+    std::error_code error;
+    auto path = fs::weakly_canonical(fileName, error);
+    if (error)
+        path = fs::path(fileName).lexically_normal();
+
+    return path.string() + "|" + std::to_string(type) + "|" + std::to_string(clamp);
+}
+
+TextureHandle TextureCache::Get(GLenum type, const std::string& fileName, GLenum clamp)
+{
+    const auto key = GetKey(type, fileName, clamp);
+
+    auto entry = m_Textures.find(key);
+    if (entry != m_Textures.end())
+        return entry->second;
+
+    auto texture = TextureHandle::Create(new GLTexture(type, fileName, clamp));
+    if (texture->m_Handle != 0)
+        m_Textures[key] = texture;
+
+    return texture;
+}
+
+std::vector<TextureHandle> TextureCache::Get2D(const std::vector<std::string>& fileNames,
+                                               GLenum clamp)
+{
+    ReleaseUnused();
+
+    std::vector<std::string> keys;
+    keys.reserve(fileNames.size());
+
+    // Files not cached yet, each one once.
+    std::vector<std::string> loadFiles;
+    std::vector<std::string> loadKeys;
+    std::unordered_set<std::string> pendingKeys;
+
+    for (const auto& fileName : fileNames)
+    {
+        keys.push_back(GetKey(GL_TEXTURE_2D, fileName, clamp));
+        if (!m_Textures.contains(keys.back()) && pendingKeys.insert(keys.back()).second)
+        {
+            loadFiles.push_back(fileName);
+            loadKeys.push_back(keys.back());
+        }
+    }
+
+    // Failed loads are still returned, but only for this request.
+    const auto loaded = LoadTextures2D(loadFiles, clamp);
+    std::unordered_map<std::string, TextureHandle> failedTextures;
+    for (size_t i = 0; i < loaded.size(); i++)
+    {
+        if (loaded[i]->m_Handle != 0)
+            m_Textures[loadKeys[i]] = loaded[i];
+        else
+            failedTextures[loadKeys[i]] = loaded[i];
+    }
+
+    LOG_INFO("TextureCache: ", fileNames.size(), " textures requested, ", loadFiles.size(),
+             " loaded, ", m_Textures.size(), " cached in total");
+
+    std::vector<TextureHandle> textures;
+    textures.reserve(keys.size());
+    for (const auto& key : keys)
+    {
+        const auto entry = m_Textures.find(key);
+        textures.push_back((entry != m_Textures.end()) ? entry->second : failedTextures[key]);
+    }
+
+    return textures;
+}
+
+void TextureCache::ReleaseUnused()
+{
+    std::erase_if(m_Textures, [](const auto& entry) { return entry.second->GetRefCount() == 1; });
+}
+
+void TextureCache::Clear()
+{
+    m_Textures.clear();
+}
+
+} // namespace Nerine
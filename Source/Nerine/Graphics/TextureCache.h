@@ -0,0 +1,57 @@
+#pragma once
+
+#include "GLResources.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Nerine
+{
+
+/*
+ * Shares textures loaded from files. Repeated loads of the same file return the same texture,
+ * so it is decoded, uploaded and made resident once. Entries are keyed by the canonical path of
+ * the file together with the texture type and wrap mode. Failed loads are not cached, so a later
+ * request loads the file again.
+ *
+ * The cache holds strong references. Textures no one else references any more are released by
+ * ReleaseUnused(), which also runs before every Get2D() batch.
+ *
+ * Textures are GL objects, the cache must only be used from the thread owning the GL context.
+ */
+class TextureCache
+{
+public:
+    static TextureCache& GetInstance();
+
+    NON_COPYABLE(TextureCache);
+    NON_MOVEABLE(TextureCache);
+
+    TextureHandle Get(GLenum type, const std::string& fileName, GLenum clamp = GL_REPEAT);
+
+    /*
+     * Returns a 2D texture per file name. Files that are not cached yet are decoded in parallel.
+     */
+    std::vector<TextureHandle> Get2D(const std::vector<std::string>& fileNames,
+                                     GLenum clamp = GL_REPEAT);
+
+    /*
+     * Drops the entries only referenced by the cache, e.g. the textures of an unloaded scene.
+     */
+    void ReleaseUnused();
+
+    /*
+     * Drops the references held by the cache. Has to run before the GL context is destroyed.
+     */
+    void Clear();
+
+private:
+    TextureCache() = default;
+
+    static std::string GetKey(GLenum type, const std::string& fileName, GLenum clamp);
+
+    std::unordered_map<std::string, TextureHandle> m_Textures;
+};
+
+} // namespace Nerine
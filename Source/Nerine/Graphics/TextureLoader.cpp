@@ -0,0 +1,81 @@
+#include "TextureLoader.h"
+
+#include <Core/Logger.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace Nerine
+{
+
+std::vector<TextureHandle> LoadTextures2D(const std::vector<std::string>& fileNames,
+                                          GLenum clamp, u32 workerCount)
+{
+    std::vector<TextureHandle> textures(fileNames.size());
+    if (fileNames.empty())
+        return textures;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    if (workerCount == 0)
+        workerCount = std::max(std::thread::hardware_concurrency(), 1u);
+    workerCount = std::min<u32>(workerCount, (u32)fileNames.size());
+
+    // Decoded images wait here for the upload. The queue is bounded so decoding cannot run
+    // arbitrarily far ahead of the uploads and hold every image in memory at once.
+    const size_t maxQueuedImages = workerCount * 2;
+    std::deque<std::pair<size_t, TextureImage2D>> queue;
+    std::mutex queueMutex;
+    std::condition_variable imageReady;
+    std::condition_variable queueSpace;
+
+    std::atomic<size_t> nextFile = 0;
+
+    auto worker = [&]() {
+        for (size_t i = nextFile++; i < fileNames.size(); i = nextFile++)
+        {
+            TextureImage2D image = DecodeTexture2D(fileNames[i]);
+
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueSpace.wait(lock, [&]() { return queue.size() < maxQueuedImages; });
+            queue.emplace_back(i, std::move(image));
+            lock.unlock();
+
+            imageReady.notify_one();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (u32 i = 0; i < workerCount; i++)
+        workers.emplace_back(worker);
+
+    for (size_t uploaded = 0; uploaded < fileNames.size(); uploaded++)
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        imageReady.wait(lock, [&]() { return !queue.empty(); });
+        auto [index, image] = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+
+        queueSpace.notify_one();
+
+        textures[index] = TextureHandle::Create(new GLTexture(image, clamp));
+    }
+
+    for (auto& thread : workers)
+        thread.join();
+
+    const auto end = std::chrono::steady_clock::now();
+    LOG_INFO("Loaded ", fileNames.size(), " textures with ", workerCount, " workers in ",
+             std::chrono::duration<double, std::milli>(end - start).count(), " ms");
+
+    return textures;
+}
+
+} // namespace Nerine
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "GLResources.h"
+
+#include <string>
+#include <vector>
+
+namespace Nerine
+{
+
+/*
+ * Loads 2D textures in bulk. Files are decoded on worker threads while the calling thread, which
+ * must own the GL context, uploads each one as soon as it is decoded. Returned textures are in
+ * the order of fileNames. A worker count of 0 uses one worker per hardware thread.
+ */
+std::vector<TextureHandle> LoadTextures2D(const std::vector<std::string>& fileNames,
+                                          GLenum clamp = GL_REPEAT, u32 workerCount = 0);
+
+} // namespace Nerine
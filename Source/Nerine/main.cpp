@@ -14,6 +14,7 @@
 #include "Graphics/GLImGui.h"
 #include "Graphics/RenderScene.h"
 #include "Graphics/RenderUtils.h"
+#include "Graphics/TextureCache.h"
 
 using namespace Nerine;
 
@@ -99,8 +100,13 @@ struct ApplicationRenderState
 
     mat4 cullingView{mainCamera.GetViewMatrix()};
     bool enableGPUCulling{true};
+    // Cull on the CPU against the shape BVH instead of in the culling compute shader.
+    bool cullOnCPU{false};
     bool freezeCullingView{false};
 
+    // Screen-space error budget of LOD selection, 0 always draws LOD 0.
+    float lodPixelError{1.0f};
+
     bool enableSSAO{true};
     bool enableSSAOBlur{true};
 
@@ -289,10 +295,7 @@ int main(int argc, char* argv[])
     auto fsShadow = CreateShader("Shaders/Scene/Shadow.fs.glsl");
     auto programShadowMap = CreateProgram(vsShadow, fsShadow);
 
-    // XXX: Make this constexpr.
-    const GLuint MaxNumObjects = 128 * 1024;
     const GLsizeiptr BufferSize_SceneData = sizeof(GPUSceneData);
-    const GLsizeiptr BufferSize_BoundingBoxes = sizeof(BoundingBox) * MaxNumObjects;
     const GLuint BufferIndex_BoundingBoxes = BUFFER_INDEX_PERFRAME_UNIFORMS + 1;
     const GLuint BufferIndex_DrawCommands = BUFFER_INDEX_PERFRAME_UNIFORMS + 2;
     const GLuint BufferIndex_NumVisibleMeshes = BUFFER_INDEX_PERFRAME_UNIFORMS + 3;
@@ -311,8 +314,6 @@ int main(int argc, char* argv[])
     glBindBufferRange(GL_UNIFORM_BUFFER, BUFFER_INDEX_PERFRAME_UNIFORMS, bufferSceneData->m_Handle,
                       0, BufferSize_SceneData);
 
-    auto bufferBoundingBoxes
-        = CreateBuffer(BufferSize_BoundingBoxes, nullptr, GL_DYNAMIC_STORAGE_BIT);
     auto bufferNumVisibleMeshes = CreateBuffer(sizeof(u32), nullptr,
                                                GL_MAP_READ_BIT | GL_MAP_WRITE_BIT
                                                    | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
@@ -354,9 +355,7 @@ int main(int argc, char* argv[])
     auto bufferIndirectMeshesTransparent = CreateIndirectBuffer(sceneData.shapes.size());
 
     auto IsTransparent = [&](const DrawElementsIndirectCommand& c) {
-        const auto mtlIndex = c.baseInstance & 0xffff;
-        const auto& mtl = sceneData.materials[mtlIndex];
-        return (mtl.flags & u32(MaterialFlags::TRANSPARENT)) > 0;
+        return (sceneData.shapes[c.baseInstance].flags & u32(DrawFlags::TRANSPARENT)) > 0;
     };
 
     mesh.m_BufferIndirect->SelectDrawCommands(
@@ -450,24 +449,14 @@ int main(int argc, char* argv[])
     };
 
     /*
-     * Bounding boxes.
+     * Bounding boxes, world space boxes of the shapes are kept up to date by GLMesh.
      */
-    std::vector<BoundingBox> reorderedBoxes;
-    reorderedBoxes.reserve(sceneData.shapes.size());
-
-    // Transform bounding boxes to world space.
-    for (const auto& drawData : sceneData.shapes)
-    {
-        const mat4 model = sceneData.scene.globalTransforms[drawData.transformIndex];
-        reorderedBoxes.push_back(sceneData.meshData.boundingBoxes[drawData.meshIndex]);
-        reorderedBoxes.back().Transform(model);
-    }
-    glNamedBufferSubData(bufferBoundingBoxes->m_Handle, 0,
-                         reorderedBoxes.size() * sizeof(BoundingBox), reorderedBoxes.data());
+    // Nodes moved since the last frame, see RecalculateGlobalTransforms.
+    std::vector<u32> updatedNodes;
 
     // Bounding box for the whole scene.
-    BoundingBox wholeSceneBBox = reorderedBoxes.front();
-    for (const auto& b : reorderedBoxes)
+    BoundingBox wholeSceneBBox = mesh.m_WorldBoxes.front();
+    for (const auto& b : mesh.m_WorldBoxes)
     {
         wholeSceneBBox.CombinePoint(b.min);
         wholeSceneBBox.CombinePoint(b.max);
@@ -475,6 +464,7 @@ int main(int argc, char* argv[])
 
     // Sync flags.
     GLsync fenceCulling = nullptr;
+    bool culledOnCPU = false;
 
     /*
      * TAA setup.
@@ -553,6 +543,17 @@ int main(int argc, char* argv[])
 
         mainCameraController.Update(deltaSeconds, mouseState.pos, mouseState.pressedLeft);
 
+        // Sync the nodes changed since the last frame, only their draws are updated and uploaded.
+        // The scene box only grows here, which keeps the shadow frustum conservative.
+        updatedNodes.clear();
+        RecalculateGlobalTransforms(sceneData.scene, &updatedNodes);
+        mesh.UpdateTransforms(updatedNodes);
+        for (const u32 shape : mesh.m_UpdatedShapes)
+        {
+            wholeSceneBBox.CombinePoint(mesh.m_WorldBoxes[shape].min);
+            wholeSceneBBox.CombinePoint(mesh.m_WorldBoxes[shape].max);
+        }
+
         glfwGetFramebufferSize(windowPtr, &windowWidth, &windowHeight);
         const float ratio = windowWidth / (float)windowHeight;
 
@@ -604,6 +605,17 @@ int main(int argc, char* argv[])
             renderState.cullingView = mainCamera.GetViewMatrix();
         }
 
+        // LOD selection, the draw commands are rewritten before being culled.
+        {
+            const vec3 cameraPos = mainCamera.GetPosition();
+            const float pixelsPerUnit = proj[1][1] * (float)windowHeight * 0.5f;
+            const IndirectBufferHandle indirectBuffers[] = {
+                mesh.m_BufferIndirect, bufferIndirectMeshesOpaque, bufferIndirectMeshesTransparent};
+            mesh.SelectLODs(cameraPos, pixelsPerUnit, renderState.lodPixelError);
+            for (const auto& indirectBuffer : indirectBuffers)
+                mesh.ApplyLODs(indirectBuffer);
+        }
+
         GPUSceneData sceneData;
         sceneData.view = view;
         sceneData.proj = proj;
@@ -622,12 +634,22 @@ int main(int argc, char* argv[])
         ClearTransparencyBuffers();
 
         // Culling. XXX: Do not dispatch compute when GPU culling is not enabled.
+        const bool cullOnCPU = renderState.enableGPUCulling && renderState.cullOnCPU;
+        if (cullOnCPU)
+        {
+            // The compute shader rewrites every instance count, upload all after it ran.
+            mesh.SelectVisibleShapes(sceneData.frustumPlanes, sceneData.frustumCorners);
+            *mappedNumVisibleMeshesPtr
+                = mesh.ApplyVisibility(bufferIndirectMeshesOpaque, !culledOnCPU)
+                  + mesh.ApplyVisibility(bufferIndirectMeshesTransparent, !culledOnCPU);
+        }
+        else
         {
             *mappedNumVisibleMeshesPtr = 0;
             programCull->Use();
             glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
             glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BufferIndex_BoundingBoxes,
-                             bufferBoundingBoxes->m_Handle);
+                             mesh.m_BufferBoundingBoxes->m_Handle);
             glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BufferIndex_NumVisibleMeshes,
                              bufferNumVisibleMeshes->m_Handle);
 
@@ -656,6 +678,7 @@ int main(int argc, char* argv[])
                             | GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
             fenceCulling = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
         }
+        culledOnCPU = cullOnCPU;
 
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BufferIndex_TransparencyLists,
                          bufferOITTransparencyLists->m_Handle);
@@ -984,7 +1007,7 @@ int main(int argc, char* argv[])
         }
 
         // Compute synchronization.
-        if (renderState.enableGPUCulling && fenceCulling)
+        if (fenceCulling)
         {
             for (;;)
             {
@@ -993,6 +1016,7 @@ int main(int argc, char* argv[])
                     break;
             }
             glDeleteSync(fenceCulling);
+            fenceCulling = nullptr;
         }
 
         glViewport(0, 0, windowWidth, windowHeight);
@@ -1033,9 +1057,11 @@ int main(int argc, char* argv[])
         ImGui::Indent(indentSize);
         ImGui::Checkbox("Enable Cull", &renderState.enableGPUCulling);
         ImGuiPushFlagsAndStyles(renderState.enableGPUCulling);
+        ImGui::Checkbox("Cull on CPU (BVH)", &renderState.cullOnCPU);
         ImGui::Checkbox("Freeze Culling", &renderState.freezeCullingView);
         ImGui::Text("Visible Mesh Count: %i", *mappedNumVisibleMeshesPtr);
         ImGuiPopFlagsAndStyles();
+        ImGui::SliderFloat("LOD Pixel Error", &renderState.lodPixelError, 0.0f, 10.0f);
         ImGui::Unindent(indentSize);
         ImGui::Separator();
 
@@ -1135,5 +1161,8 @@ int main(int argc, char* argv[])
     glUnmapNamedBuffer(bufferNumVisibleMeshes->m_Handle);
     glDeleteTextures(1, &luminance1x1);
 
+    // Cached textures have to go while the GL context is alive.
+    TextureCache::GetInstance().Clear();
+
     return 0;
 }
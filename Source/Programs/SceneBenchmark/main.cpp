@@ -0,0 +1,452 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <Core/Logger.h>
+#include <Core/MathSIMD.h>
+#include <Core/Types.h>
+
+#include <RenderDescription/BVH.h>
+#include <RenderDescription/Frustum.h>
+#include <RenderDescription/Mesh.h>
+#include <RenderDescription/Scene.h>
+
+namespace fs = std::filesystem;
+
+using namespace Nerine;
+
+namespace
+{
+
+constexpr u32 DEFAULT_NODE_COUNT = 1'000'000;
+
+// Children per node of the generated hierarchy, nodes are added breadth first.
+constexpr u32 BRANCHING_FACTOR = 8;
+
+/*
+ * Runs fn once and returns the wall time in milliseconds.
+ */
+template <typename Fn> double Time(Fn&& fn)
+{
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <typename Fn> double Measure(const std::string& name, Fn&& fn)
+{
+    const double ms = Time(fn);
+    LOG_INFO(name, ": ", ms, " ms");
+
+    return ms;
+}
+
+/*
+ * Balanced hierarchy where roughly half the nodes carry a mesh and a material, similar to the
+ * node/mesh sub node split of converted scenes. Every node is named and has a random translation
+ * and rotation.
+ */
+void BuildScene(Scene& scene, u32 nodeCount, u32 seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    AddNode(scene, u32(-1), 0);
+    SetNodeName(scene, 0, "Root");
+
+    for (u32 i = 1; i < nodeCount; i++)
+    {
+        const u32 parent = (i - 1) / BRANCHING_FACTOR;
+        const u32 node = AddNode(scene, parent, scene.hierarchy[parent].level + 1);
+
+        const vec3 translation(offset(rng), offset(rng), offset(rng));
+        const quat rotation = glm::normalize(quat(unit(rng), unit(rng), unit(rng), unit(rng)));
+        mat4 local;
+        ComposeAffine(translation, rotation, vec3(1.0f), local);
+        scene.localTransforms[node] = local;
+
+        SetNodeName(scene, node, "Node_" + std::to_string(node));
+
+        if (node % 2 == 0)
+        {
+            scene.nodeMeshes[node] = node % 4096;
+            scene.nodeMaterials[node] = node % 256;
+        }
+    }
+}
+
+void BenchmarkSceneStorage(u32 nodeCount)
+{
+    LOG_INFO("Scene storage, ", nodeCount, " nodes");
+
+    Scene scene;
+    Measure("Build", [&]() { BuildScene(scene, nodeCount, 1); });
+
+    // Same walk as GLSceneData::LoadSceneFile.
+    u64 checksum = 0;
+    Measure("Gather shapes", [&]() {
+        for (u32 node = 0; node < scene.nodeMeshes.size(); node++)
+        {
+            if (scene.nodeMeshes[node] != u32(-1) && scene.nodeMaterials[node] != u32(-1))
+                checksum += scene.nodeMeshes[node] + node;
+        }
+    });
+
+    u32 found = u32(-1);
+    Measure("Find last node by name", [&]() {
+        found = FindNodeByName(scene, "Node_" + std::to_string(nodeCount - 1));
+    });
+
+    const auto fileName = (fs::temp_directory_path() / "SceneBenchmark.scene").string();
+    Measure("Save", [&]() { SaveScene(fileName, scene); });
+    const auto fileSize = fs::file_size(fileName);
+
+    Scene loadedScene;
+    Measure("Load", [&]() { LoadScene(fileName, loadedScene); });
+
+    {
+        SceneDataView sceneData;
+        Measure("Map", [&]() { LoadScene(fileName, sceneData); });
+    }
+
+    Measure("Save with checksums", [&]() { SaveScene(fileName, scene, true); });
+    Measure("Load with checksums", [&]() { LoadScene(fileName, loadedScene); });
+
+    Scene trsScene = scene;
+    Measure("Convert to TRS", [&]() { ConvertToTRSLocalTransforms(trsScene); });
+    Measure("Save TRS", [&]() { SaveScene(fileName, trsScene); });
+    const auto trsFileSize = fs::file_size(fileName);
+    Measure("Load TRS", [&]() { LoadScene(fileName, loadedScene); });
+    fs::remove(fileName);
+
+    LOG_INFO("File size: ", fileSize, " bytes, ", trsFileSize, " bytes with TRS");
+
+    Scene otherScene;
+    BuildScene(otherScene, nodeCount, 2);
+
+    Scene mergedScene;
+    Measure("Merge two scenes", [&]() {
+        MergeScenes(mergedScene, {&scene, &otherScene}, {}, {4096, 4096});
+    });
+
+    // Every tenth node of the merged scene, most of them leaves.
+    std::vector<u32> nodesToDelete;
+    for (u32 node = 1; node < mergedScene.hierarchy.size(); node += 10)
+        nodesToDelete.push_back(node);
+
+    Measure("Delete " + std::to_string(nodesToDelete.size()) + " nodes",
+            [&]() { DeleteSceneNodes(mergedScene, nodesToDelete); });
+
+    LOG_INFO("Checksum ", checksum, ", found node ", found, ", loaded ",
+             loadedScene.hierarchy.size(), " nodes, ", mergedScene.hierarchy.size(),
+             " nodes left after the merge and delete");
+}
+
+/*
+ * The plain glm path RecalculateGlobalTransforms has to match bit for bit.
+ */
+void RecalculateGlobalTransformsReference(Scene& scene)
+{
+    for (u32 node = 0; node < scene.hierarchy.size(); node++)
+    {
+        const u32 parent = scene.hierarchy[node].parent;
+        scene.globalTransforms[node] = (parent == u32(-1))
+                                           ? scene.localTransforms[node]
+                                           : scene.globalTransforms[parent]
+                                                 * scene.localTransforms[node];
+    }
+}
+
+void BenchmarkTransforms(u32 nodeCount)
+{
+    constexpr u32 iterations = 10;
+
+    LOG_INFO("Global transforms, ", nodeCount, " nodes");
+
+    Scene scene;
+    BuildScene(scene, nodeCount, 1);
+
+    Scene referenceScene = scene;
+
+    // Parents always precede their children in the generated scene.
+    const double referenceTime = Time([&]() {
+        for (u32 i = 0; i < iterations; i++)
+            RecalculateGlobalTransformsReference(referenceScene);
+    });
+
+    // Marking is not part of the propagation and is left out of the timing.
+    double time = 0.0;
+    for (u32 i = 0; i < iterations; i++)
+    {
+        MarkAsChanged(scene, 0);
+        time += Time([&]() { RecalculateGlobalTransforms(scene); });
+    }
+
+    const bool identical = memcmp(scene.globalTransforms.data(),
+                                  referenceScene.globalTransforms.data(),
+                                  sizeof(mat4) * scene.globalTransforms.size())
+                           == 0;
+
+    LOG_INFO("Per update: ", referenceTime / iterations, " ms reference, ", time / iterations,
+             " ms, results ", identical ? "identical" : "DIFFERENT");
+
+    // TRS composition rounds differently, compare within a tolerance.
+    Scene trsScene = scene;
+    ConvertToTRSLocalTransforms(trsScene);
+
+    double trsTime = 0.0;
+    for (u32 i = 0; i < iterations; i++)
+    {
+        MarkAsChanged(trsScene, 0);
+        trsTime += Time([&]() { RecalculateGlobalTransforms(trsScene); });
+    }
+
+    float maxError = 0.0f;
+    for (u32 node = 0; node < nodeCount; node++)
+    {
+        const mat4& a = trsScene.globalTransforms[node];
+        const mat4& b = referenceScene.globalTransforms[node];
+        for (u32 c = 0; c < 4; c++)
+        {
+            for (u32 r = 0; r < 4; r++)
+            {
+                const float error = std::abs(a[c][r] - b[c][r]) / (1.0f + std::abs(b[c][r]));
+                maxError = std::max(maxError, error);
+            }
+        }
+    }
+
+    LOG_INFO("Per TRS update: ", trsTime / iterations, " ms, max relative error ", maxError);
+}
+
+/*
+ * Random boxes in a cube, seen from the middle of one of its faces.
+ */
+void BenchmarkBVH(u32 boxCount)
+{
+    constexpr u32 iterations = 10;
+    constexpr float worldSize = 1000.0f;
+
+    LOG_INFO("BVH, ", boxCount, " boxes");
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> position(-worldSize, worldSize);
+    std::uniform_real_distribution<float> extent(0.5f, 10.0f);
+
+    std::vector<BoundingBox> boxes(boxCount);
+    for (auto& box : boxes)
+    {
+        const vec3 min(position(rng), position(rng), position(rng));
+        box = BoundingBox(min, min + vec3(extent(rng), extent(rng), extent(rng)));
+    }
+
+    const mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, worldSize);
+    const mat4 view = glm::lookAt(vec3(0.0f, 0.0f, worldSize), vec3(0.0f), vec3(0.0f, 1.0f, 0.0f));
+    vec4 frustumPlanes[6];
+    vec4 frustumCorners[8];
+    GetFrustumPlanes(proj * view, frustumPlanes);
+    GetFrustumCorners(proj * view, frustumCorners);
+
+    std::vector<u32> expected;
+    const auto BruteForce = [&]() {
+        expected.clear();
+        for (u32 i = 0; i < boxCount; i++)
+        {
+            if (IsBoxInFrustum(frustumPlanes, frustumCorners, boxes[i]))
+                expected.push_back(i);
+        }
+    };
+
+    BVH bvh;
+    Measure("Build", [&]() { bvh.Build(boxes); });
+
+    std::vector<u32> visible;
+    const auto Query = [&]() { bvh.QueryFrustum(frustumPlanes, frustumCorners, visible); };
+
+    const auto IsIdentical = [&]() {
+        std::sort(visible.begin(), visible.end());
+        return visible == expected;
+    };
+
+    const double bruteForceTime = Time([&]() {
+        for (u32 i = 0; i < iterations; i++)
+            BruteForce();
+    });
+    const double queryTime = Time([&]() {
+        for (u32 i = 0; i < iterations; i++)
+            Query();
+    });
+
+    LOG_INFO("Per query: ", bruteForceTime / iterations, " ms brute force, ",
+             queryTime / iterations, " ms, ", visible.size(), " of ", boxCount,
+             " visible, results ", IsIdentical() ? "identical" : "DIFFERENT");
+
+    // Every hundredth box moves a bit.
+    std::uniform_real_distribution<float> offset(-5.0f, 5.0f);
+    std::vector<u32> movedItems;
+    for (u32 i = 0; i < boxCount; i += 100)
+    {
+        const vec3 delta(offset(rng), offset(rng), offset(rng));
+        boxes[i] = BoundingBox(boxes[i].min + delta, boxes[i].max + delta);
+        movedItems.push_back(i);
+    }
+
+    Measure("Refit moved boxes", [&]() { bvh.Refit(movedItems, boxes); });
+    Measure("Refit all", [&]() { bvh.Refit(boxes); });
+
+    BruteForce();
+    Query();
+    LOG_INFO("After refit, results ", IsIdentical() ? "identical" : "DIFFERENT");
+}
+
+/*
+ * Brute force CullMeshlets for uniformly scaled models, done in mesh space: the planes and the
+ * camera are moved to the meshlets instead of the other way round. tolerance grows the spheres
+ * and cone cutoffs, a negative one shrinks them, so boundary cases can go either way.
+ */
+void CullMeshletsReference(std::span<const MeshletBounds> meshletBounds, const mat4& model,
+                           const vec4* frustumPlanes, const vec3& cameraPos, float tolerance,
+                           std::vector<u32>& visibleMeshlets)
+{
+    // A world space plane p is transpose(model) * p in mesh space.
+    vec4 planes[6];
+    for (int i = 0; i < 6; i++)
+    {
+        planes[i] = glm::transpose(model) * frustumPlanes[i];
+        planes[i] /= glm::length(vec3(planes[i]));
+    }
+    const vec3 camera = vec3(glm::inverse(model) * vec4(cameraPos, 1.0f));
+
+    visibleMeshlets.clear();
+    for (u32 i = 0; i < meshletBounds.size(); i++)
+    {
+        const auto& bounds = meshletBounds[i];
+
+        bool visible = true;
+        for (int p = 0; p < 6 && visible; p++)
+        {
+            visible = glm::dot(planes[p], vec4(bounds.center, 1.0f))
+                      >= -(bounds.radius + tolerance);
+        }
+
+        if (visible && bounds.coneCutoff < 1.0f)
+        {
+            visible = glm::dot(glm::normalize(bounds.coneApex - camera), bounds.coneAxis)
+                      < bounds.coneCutoff + tolerance;
+        }
+
+        if (visible)
+            visibleMeshlets.push_back(i);
+    }
+}
+
+/*
+ * Random meshlets of one mesh under a rotated, scaled and translated model, part of them behind
+ * the camera and some with degenerate cones.
+ */
+void BenchmarkMeshletCulling(u32 meshletCount)
+{
+    constexpr u32 iterations = 10;
+    constexpr float meshSize = 100.0f;
+    constexpr float tolerance = 1e-3f;
+
+    LOG_INFO("Meshlet culling, ", meshletCount, " meshlets");
+
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<float> position(-meshSize, meshSize);
+    std::uniform_real_distribution<float> radius(0.5f, 5.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> cutoff(-0.5f, 1.0f);
+
+    std::vector<MeshletBounds> meshletBounds(meshletCount);
+    for (auto& bounds : meshletBounds)
+    {
+        bounds.center = vec3(position(rng), position(rng), position(rng));
+        bounds.radius = radius(rng);
+        bounds.coneAxis = glm::normalize(vec3(unit(rng), unit(rng), unit(rng)) + vec3(1e-3f));
+        bounds.coneApex = bounds.center - bounds.coneAxis * bounds.radius;
+        bounds.coneCutoff = std::min(cutoff(rng) * 1.2f, 1.0f);
+    }
+
+    Mesh mesh;
+    mesh.meshletOffset = 0;
+    mesh.meshletCount = meshletCount;
+
+    // Uniformly scaled, rotated and moved in front of the camera.
+    mat4 model = glm::translate(mat4(1.0f), vec3(0.0f, 0.0f, -150.0f));
+    model = glm::rotate(model, 0.5f, glm::normalize(vec3(1.0f, 1.0f, 0.0f)));
+    model = glm::scale(model, vec3(2.0f));
+
+    const vec3 cameraPos(0.0f);
+    const mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    const mat4 view = glm::lookAt(cameraPos, vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
+    vec4 frustumPlanes[6];
+    GetFrustumPlanes(proj * view, frustumPlanes);
+
+    std::vector<u32> expected;
+    const double bruteForceTime = Time([&]() {
+        for (u32 i = 0; i < iterations; i++)
+            CullMeshletsReference(meshletBounds, model, frustumPlanes, cameraPos, 0.0f, expected);
+    });
+
+    std::vector<u32> visible;
+    const double cullTime = Time([&]() {
+        for (u32 i = 0; i < iterations; i++)
+        {
+            visible.clear();
+            CullMeshlets(mesh, meshletBounds, model, frustumPlanes, cameraPos, visible);
+        }
+    });
+
+    // Everything visible with shrunk bounds has to be found, nothing invisible with grown ones.
+    std::vector<u32> expectedStrict;
+    std::vector<u32> expectedLoose;
+    CullMeshletsReference(meshletBounds, model, frustumPlanes, cameraPos, -tolerance,
+                          expectedStrict);
+    CullMeshletsReference(meshletBounds, model, frustumPlanes, cameraPos, tolerance,
+                          expectedLoose);
+    const bool matches
+        = std::includes(visible.begin(), visible.end(), expectedStrict.begin(),
+                        expectedStrict.end())
+          && std::includes(expectedLoose.begin(), expectedLoose.end(), visible.begin(),
+                           visible.end());
+
+    LOG_INFO("Per cull: ", bruteForceTime / iterations, " ms brute force, ",
+             cullTime / iterations, " ms, ", visible.size(), " of ", meshletCount, " visible (",
+             expected.size(), " brute force), results ", matches ? "match" : "DIFFERENT");
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    LOG_SET_OUTPUT(&std::cout);
+
+    const u32 nodeCount = (argc > 1) ? (u32)std::stoul(argv[1]) : DEFAULT_NODE_COUNT;
+    if (nodeCount == 0)
+    {
+        LOG_FATAL("USAGE: SceneBenchmark [node count]");
+    }
+
+    BenchmarkSceneStorage(nodeCount);
+
+    for (u32 transformNodeCount : {10'000u, 100'000u, 1'000'000u})
+        BenchmarkTransforms(transformNodeCount);
+
+    for (u32 boxCount : {10'000u, 100'000u, 1'000'000u})
+        BenchmarkBVH(boxCount);
+
+    for (u32 meshletCount : {10'000u, 100'000u, 1'000'000u})
+        BenchmarkMeshletCulling(meshletCount);
+
+    return 0;
+}
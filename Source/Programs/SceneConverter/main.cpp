@@ -1,9 +1,20 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <execution>
 #include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <span>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <assimp/Importer.hpp>
@@ -22,15 +33,24 @@
 
 #include <meshoptimizer.h>
 
+#include <gli/gli.hpp>
+#include <gli/save_ktx.hpp>
+#include <gli/texture2d.hpp>
+
+#include <Hash.h>
 #include <Logger.h>
+#include <MappedFile.h>
 
 #include <RenderDescription/Material.h>
 #include <RenderDescription/Mesh.h>
 #include <RenderDescription/Scene.h>
+#include <RenderDescription/TextureCompression.h>
 #include <RenderDescription/Utils.h>
 
 namespace fs = std::filesystem;
 
+using namespace Nerine;
+
 struct SceneConfig
 {
     std::string fileName;
@@ -41,8 +61,92 @@ struct SceneConfig
     float scale;
     bool calculateLODs;
     bool mergeInstances{false};
+    bool compressMeshes{true};
+    bool quantizeVertices{false};
+    // Meshes with at most 65536 vertices use the 16-bit index pool.
+    bool allow16BitIndices{true};
+    bool buildMeshlets{false};
+    // Store node transforms as translation, rotation and scale if none of them has shear.
+    bool storeTRSTransforms{false};
+
+    // GPU efficiency optimizations applied to every LOD after simplification.
+    bool optimizeVertexCache{true};
+    bool optimizeOverdraw{true};
+    bool optimizeVertexFetch{true};
+    // Maximum allowed vertex cache degradation of the overdraw optimization.
+    float overdrawThreshold{1.05f};
+
+    // Texture conversion threads, 0 uses one per hardware thread.
+    u32 textureWorkerCount{0};
+    // Upper bound of full resolution texture data decoded at the same time.
+    size_t textureMemoryBudget{size_t(2) << 30};
+
+    // Converted textures and meshes are cached here keyed by the hash of their inputs, empty
+    // disables the cache.
+    std::string cacheDirectory;
 };
 
+// Bump when the conversion code changes in a way that invalidates cached results.
+static constexpr u64 CONVERSION_CACHE_VERSION = 2;
+
+/*
+ * Hashes the contents of a file, returns false if the file cannot be read.
+ */
+bool HashFile(const std::string& fileName, u64& hash)
+{
+    if (!fs::exists(fileName))
+        return false;
+
+    MappedFile file;
+    if (!file.Open(fileName))
+        return false;
+
+    hash = HashBytes(file.GetData(), file.GetSize(), hash);
+    return true;
+}
+
+std::string GetCacheFileName(const std::string& cacheDirectory, const std::string& category,
+                             u64 key, const std::string& extension)
+{
+    std::ostringstream oss;
+    oss << cacheDirectory << "/" << category << "/" << std::hex << std::setw(16)
+        << std::setfill('0') << key << extension;
+    return oss.str();
+}
+
+/*
+ * Temporary file to write a cache entry to before renaming it onto the entry. Inputs with the same
+ * contents share a key, so the name has to be unique per writer, not per entry.
+ */
+std::string GetCacheTempFileName(const std::string& cacheFileName)
+{
+    thread_local std::mt19937_64 rng(std::random_device{}());
+
+    std::ostringstream oss;
+    oss << cacheFileName << "." << std::hex << rng() << ".tmp";
+    return oss.str();
+}
+
+/*
+ * Copies a finished output into the cache. The copy goes through a temporary file so an
+ * interrupted run or a concurrent writer of the same entry never leaves a truncated entry behind.
+ */
+void StoreCacheFile(const std::string& fileName, const std::string& cacheFileName)
+{
+    const std::string tmpFileName = GetCacheTempFileName(cacheFileName);
+
+    std::error_code error;
+    fs::copy_file(fileName, tmpFileName, fs::copy_options::overwrite_existing, error);
+    if (!error)
+        fs::rename(tmpFileName, cacheFileName, error);
+
+    if (error)
+    {
+        LOG_ERROR("Failed to store ", fileName, " in the conversion cache: ", error.message());
+        fs::remove(tmpFileName, error);
+    }
+}
+
 glm::mat4 ToMat4(const aiMatrix4x4& from)
 {
     glm::mat4 to;
@@ -65,28 +169,24 @@ glm::mat4 ToMat4(const aiMatrix4x4& from)
     return to;
 }
 
-void Traverse(const aiScene* sourceScene, Scene& scene, aiNode* N, int parent, int ofs)
+void Traverse(const aiScene* sourceScene, Scene& scene, aiNode* N, int parent, int ofs,
+              const std::vector<u32>& meshRemap)
 {
     int newNode = AddNode(scene, parent, ofs);
 
     if (N->mName.C_Str())
-    {
-        u32 stringID = (u32)scene.names.size();
-        scene.names.push_back(std::string(N->mName.C_Str()));
-        scene.namesMap[newNode] = stringID;
-    }
+        SetNodeName(scene, newNode, N->mName.C_Str());
 
     for (size_t i = 0; i < N->mNumMeshes; i++)
     {
         int newSubNode = AddNode(scene, newNode, ofs + 1);
 
-        u32 stringID = (u32)scene.names.size();
-        scene.names.push_back(std::string(N->mName.C_Str()) + "_Mesh_" + std::to_string(i));
-        scene.namesMap[newSubNode] = stringID;
+        SetNodeName(scene, newSubNode,
+                    std::string(N->mName.C_Str()) + "_Mesh_" + std::to_string(i));
 
         int mesh = (int)N->mMeshes[i];
-        scene.meshesMap[newSubNode] = mesh;
-        scene.materialsMap[newSubNode] = sourceScene->mMeshes[mesh]->mMaterialIndex;
+        scene.nodeMeshes[newSubNode] = meshRemap[mesh];
+        scene.nodeMaterials[newSubNode] = sourceScene->mMeshes[mesh]->mMaterialIndex;
 
         scene.globalTransforms[newSubNode] = glm::mat4(1.0f);
         scene.localTransforms[newSubNode] = glm::mat4(1.0f);
@@ -96,7 +196,7 @@ void Traverse(const aiScene* sourceScene, Scene& scene, aiNode* N, int parent, i
     scene.localTransforms[newNode] = ToMat4(N->mTransformation);
 
     for (unsigned int n = 0; n < N->mNumChildren; n++)
-        Traverse(sourceScene, scene, N->mChildren[n], newNode, ofs + 1);
+        Traverse(sourceScene, scene, N->mChildren[n], newNode, ofs + 1, meshRemap);
 }
 
 std::string ReplaceAll(const std::string& str, const std::string& oldSubStr,
@@ -141,37 +241,274 @@ std::string GetFileBaseName(const std::string& path)
     return path.substr(path.find_last_of("/\\") + 1);
 }
 
-std::string ConvertTexture(const std::string& file, const std::string& basePath,
-                           std::unordered_map<std::string, u32>& opacityMapIndices,
-                           const std::vector<std::string>& opacityMaps)
+/*
+ * How a texture is sampled, decides how its mips are filtered and which block format it uses.
+ */
+enum class TextureUsage : u8
+{
+    // sRGB encoded color, mips are filtered in linear space.
+    Color,
+    // Tangent space normals, renormalized after filtering and stored as two channels.
+    Normal,
+};
+
+BlockFormat ChooseBlockFormat(TextureUsage usage, int sourceChannels, bool hasAlpha)
+{
+    if (usage == TextureUsage::Normal)
+        return BlockFormat::BC5;
+    if (sourceChannels == 1 && !hasAlpha)
+        return BlockFormat::BC4;
+
+    return hasAlpha ? BlockFormat::BC3 : BlockFormat::BC1;
+}
+
+gli::format GetKTXFormat(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        return gli::FORMAT_RGB_DXT1_UNORM_BLOCK8;
+    case BlockFormat::BC3:
+        return gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16;
+    case BlockFormat::BC4:
+        return gli::FORMAT_R_ATI1N_UNORM_BLOCK8;
+    case BlockFormat::BC5:
+        return gli::FORMAT_RG_ATI2N_UNORM_BLOCK16;
+    }
+
+    return gli::FORMAT_UNDEFINED;
+}
+
+u32 GetMipLevelCount(int width, int height)
+{
+    u32 levels = 1;
+    while ((width | height) >> levels)
+        levels++;
+
+    return levels;
+}
+
+/*
+ * Resizes an RGBA8 image with the filter matching the usage of the texture.
+ */
+void ResizeImage(const u8* src, int srcWidth, int srcHeight, u8* dst, int dstWidth, int dstHeight,
+                 TextureUsage usage)
+{
+    if (usage == TextureUsage::Color)
+    {
+        stbir_resize_uint8_srgb(src, srcWidth, srcHeight, 0, dst, dstWidth, dstHeight, 0, 4, 3,
+                                0);
+        return;
+    }
+
+    stbir_resize_uint8(src, srcWidth, srcHeight, 0, dst, dstWidth, dstHeight, 0, 4);
+
+    // Filtering shortens the normals.
+    for (int i = 0; i < dstWidth * dstHeight; i++)
+    {
+        u8* pixel = dst + i * 4;
+        vec3 n = vec3(pixel[0], pixel[1], pixel[2]) / 127.5f - vec3(1.0f);
+        n = (glm::dot(n, n) > 0.0f) ? glm::normalize(n) : vec3(0.0f, 0.0f, 1.0f);
+        for (int c = 0; c < 3; c++)
+            pixel[c] = (u8)std::lround((n[c] * 0.5f + 0.5f) * 255.0f);
+    }
+}
+
+/*
+ * Per worker buffers reused across textures, sized for the downscaled images only.
+ */
+struct TextureScratch
+{
+    // Downscaled top level.
+    std::vector<u8> image;
+    // Mip level being compressed.
+    std::vector<u8> mipLevel;
+};
+
+/*
+ * Writes the image with a full mip chain as a block compressed KTX file. Every mip is filtered
+ * from the top level.
+ */
+bool SaveCompressedTexture(const std::string& fileName, const u8* rgba, int width, int height,
+                           TextureUsage usage, BlockFormat format, TextureScratch& scratch)
+{
+    const u32 levelCount = GetMipLevelCount(width, height);
+    gli::texture2d texture(GetKTXFormat(format), gli::extent2d(width, height), levelCount);
+
+    scratch.mipLevel.resize((size_t)width * height * 4);
+
+    for (u32 level = 0; level < levelCount; level++)
+    {
+        const int levelWidth = std::max(width >> level, 1);
+        const int levelHeight = std::max(height >> level, 1);
+
+        const u8* levelPixels = rgba;
+        if (level > 0)
+        {
+            ResizeImage(rgba, width, height, scratch.mipLevel.data(), levelWidth, levelHeight,
+                        usage);
+            levelPixels = scratch.mipLevel.data();
+        }
+
+        assert(texture.size(level) == GetCompressedImageSize(format, levelWidth, levelHeight));
+        CompressImage(format, levelPixels, levelWidth, levelHeight,
+                      static_cast<u8*>(texture.data(0, 0, level)));
+    }
+
+    return gli::save_ktx(texture, fileName);
+}
+
+/*
+ * Limits the memory held by in-flight texture decodes. A request larger than the whole budget
+ * is let through once nothing else is in flight, so it cannot wait forever.
+ */
+class MemoryBudget
+{
+public:
+    explicit MemoryBudget(size_t budget) : m_Budget(budget)
+    {
+    }
+
+    NON_COPYABLE(MemoryBudget);
+    NON_MOVEABLE(MemoryBudget);
+
+    void Acquire(size_t bytes)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Condition.wait(lock, [&]() { return m_InUse == 0 || m_InUse + bytes <= m_Budget; });
+        m_InUse += bytes;
+        m_Peak = std::max(m_Peak, m_InUse);
+    }
+
+    void Release(size_t bytes)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_InUse -= bytes;
+        }
+        m_Condition.notify_all();
+    }
+
+    [[nodiscard]] size_t GetPeak() const
+    {
+        return m_Peak;
+    }
+
+private:
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+
+    size_t m_Budget{0};
+    size_t m_InUse{0};
+    size_t m_Peak{0};
+};
+
+struct TextureConversionContext
+{
+    std::string basePath;
+    std::string cacheDirectory;
+    std::unordered_map<std::string, u32> opacityMapIndices;
+    const std::vector<std::string>& opacityMaps;
+    MemoryBudget& memoryBudget;
+};
+
+struct TextureConversionStats
+{
+    std::string file;
+    int width{0};
+    int height{0};
+    // Bytes reserved from the memory budget for the decode.
+    size_t memoryReserved{0};
+    bool cached{false};
+
+    // Milliseconds spent waiting for memory, decoding and resizing, and mipmapping/compressing.
+    double waitTime{0.0};
+    double decodeTime{0.0};
+    double encodeTime{0.0};
+};
+
+double GetMilliseconds(std::chrono::steady_clock::time_point start,
+                       std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+std::string ConvertTexture(const std::string& file, TextureUsage usage,
+                           const TextureConversionContext& context, TextureScratch& scratch,
+                           TextureConversionStats& stats)
 {
+    using Clock = std::chrono::steady_clock;
+
     const auto maxNewWidth = 512;
     const auto maxNewHeight = 512;
 
-    const auto srcFile = ReplaceAll(basePath + file, "\\", "/");
+    const auto srcFile = ReplaceAll(context.basePath + file, "\\", "/");
+    stats.file = srcFile;
 
     // XXX: Make this configurable from scene config.
     const auto newFile = "bistro_textures/" +
                          // GetFileBaseName(srcFile)
                          LowercaseString(ReplaceAll(ReplaceAll(srcFile, "..", "_"), "/", "_"))
-                         + "_r.png";
+                         + "_r.ktx";
+
+    const auto opacityMap = context.opacityMapIndices.find(file);
+    const bool hasOpacityMap = opacityMap != context.opacityMapIndices.end();
+    const auto opacityMapFile
+        = hasOpacityMap
+              ? ReplaceAll(context.basePath + context.opacityMaps[opacityMap->second], "\\", "/")
+              : std::string();
+
+    // The cache key covers the source image, its opacity mask and the conversion parameters.
+    u64 cacheKey = HashCombine(HashValue(CONVERSION_CACHE_VERSION),
+                               HashCombine(HashValue(maxNewWidth), HashValue(maxNewHeight)));
+    cacheKey = HashCombine(cacheKey, HashValue(usage));
+    bool cacheable
+        = !context.cacheDirectory.empty() && HashFile(FixTextureFile(srcFile), cacheKey);
+    if (cacheable && hasOpacityMap)
+        cacheable = HashFile(FixTextureFile(opacityMapFile), cacheKey);
+
+    const std::string cacheFile
+        = cacheable ? GetCacheFileName(context.cacheDirectory, "textures", cacheKey, ".ktx") : "";
+
+    if (cacheable && fs::exists(cacheFile))
+    {
+        std::error_code error;
+        fs::copy_file(cacheFile, newFile, fs::copy_options::overwrite_existing, error);
+        if (!error)
+        {
+            LOG_INFO("Load ", srcFile, " texture from the conversion cache");
+            stats.cached = true;
+            return newFile;
+        }
+    }
+
+    // Reserve the decoded source and opacity mask before loading them.
+    int infoWidth = 0;
+    int infoHeight = 0;
+    int infoChannels = 0;
+    if (stbi_info(FixTextureFile(srcFile).c_str(), &infoWidth, &infoHeight, &infoChannels))
+        stats.memoryReserved = (size_t)infoWidth * infoHeight * (hasOpacityMap ? 5 : 4);
+
+    const auto waitStart = Clock::now();
+    context.memoryBudget.Acquire(stats.memoryReserved);
+    const auto decodeStart = Clock::now();
 
     // Load the image.
     int texWidth, texHeight, texChannels;
     stbi_uc* pixels = stbi_load(FixTextureFile(srcFile).c_str(), &texWidth, &texHeight,
                                 &texChannels, STBI_rgb_alpha);
     u8* src = pixels;
+    const int sourceChannels = texChannels;
     texChannels = STBI_rgb_alpha;
 
-    std::vector<u8> tmpImage(maxNewWidth * maxNewHeight * 4);
-
     if (!src)
     {
         LOG_ERROR("Failed to load texture: ", srcFile);
         texWidth = maxNewWidth;
         texHeight = maxNewHeight;
         texChannels = STBI_rgb_alpha;
-        src = tmpImage.data();
+        scratch.mipLevel.assign(maxNewWidth * maxNewHeight * 4, 0);
+        src = scratch.mipLevel.data();
     }
     else
     {
@@ -179,10 +516,8 @@ std::string ConvertTexture(const std::string& file, const std::string& basePath,
                  texChannels, " channels");
     }
 
-    if (opacityMapIndices.count(file) > 0)
+    if (hasOpacityMap)
     {
-        const auto opacityMapFile
-            = ReplaceAll(basePath + opacityMaps[opacityMapIndices[file]], "\\", "/");
         int opacityWidth, opacityHeight;
         stbi_uc* opacityPixels = stbi_load(FixTextureFile(opacityMapFile).c_str(), &opacityWidth,
                                            &opacityHeight, nullptr, 1);
@@ -206,39 +541,135 @@ std::string ConvertTexture(const std::string& file, const std::string& basePath,
         stbi_image_free(opacityPixels);
     }
 
-    const u32 imgSize = texWidth * texHeight * texChannels;
-    std::vector<u8> mipData(imgSize);
-    uint8_t* dst = mipData.data();
-
     const int newW = std::min(texWidth, maxNewWidth);
     const int newH = std::min(texHeight, maxNewHeight);
 
-    stbir_resize_uint8(src, texWidth, texHeight, 0, dst, newW, newH, 0, texChannels);
+    scratch.image.resize((size_t)newW * newH * 4);
+    u8* dst = scratch.image.data();
 
-    int write_res = stbi_write_png(newFile.c_str(), newW, newH, texChannels, dst, 0);
+    ResizeImage(src, texWidth, texHeight, dst, newW, newH, usage);
 
+    // The full resolution source is not needed anymore, hand its memory back to other workers.
     if (pixels)
         stbi_image_free(pixels);
+    context.memoryBudget.Release(stats.memoryReserved);
+
+    const auto encodeStart = Clock::now();
+
+    bool hasAlpha = false;
+    for (int i = 0; i < newW * newH && !hasAlpha; i++)
+        hasAlpha = dst[i * 4 + 3] != 255;
+
+    const BlockFormat format = ChooseBlockFormat(usage, sourceChannels, hasAlpha);
+    const bool saved = SaveCompressedTexture(newFile, dst, newW, newH, usage, format, scratch);
+
+    if (!saved)
+        LOG_ERROR("Failed to save texture: ", newFile);
+
+    if (cacheable && saved)
+        StoreCacheFile(newFile, cacheFile);
+
+    const auto end = Clock::now();
+    stats.width = texWidth;
+    stats.height = texHeight;
+    stats.waitTime = GetMilliseconds(waitStart, decodeStart);
+    stats.decodeTime = GetMilliseconds(decodeStart, encodeStart);
+    stats.encodeTime = GetMilliseconds(encodeStart, end);
 
     return newFile;
 }
 
+void PrintTextureConversionReport(const std::vector<TextureConversionStats>& stats,
+                                  double totalTime, size_t peakMemory, u32 workerCount)
+{
+    std::vector<const TextureConversionStats*> sorted;
+    for (const auto& s : stats)
+        sorted.push_back(&s);
+
+    std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) {
+        return a->waitTime + a->decodeTime + a->encodeTime
+               > b->waitTime + b->decodeTime + b->encodeTime;
+    });
+
+    double waitTime = 0.0;
+    double decodeTime = 0.0;
+    double encodeTime = 0.0;
+    u32 cachedCount = 0;
+
+    LOG_INFO("Texture conversion report, slowest first (wait/decode/encode ms):");
+    for (const auto* s : sorted)
+    {
+        waitTime += s->waitTime;
+        decodeTime += s->decodeTime;
+        encodeTime += s->encodeTime;
+
+        if (s->cached)
+        {
+            cachedCount++;
+            continue;
+        }
+
+        LOG_INFO("  ", s->file, " ", s->width, "x", s->height, ": ", s->waitTime, " / ",
+                 s->decodeTime, " / ", s->encodeTime);
+    }
+
+    LOG_INFO("Converted ", stats.size(), " textures (", cachedCount, " cached) in ", totalTime,
+             " ms with ", workerCount, " workers");
+    LOG_INFO("  Summed wait/decode/encode: ", waitTime, " / ", decodeTime, " / ", encodeTime,
+             " ms");
+    LOG_INFO("  Peak in-flight decode memory: ", peakMemory / (1024 * 1024), " MB");
+}
+
 void ConvertAndDownscaleAllTextures(const std::vector<MaterialDescription>& materials,
-                                    const std::string& basePath, std::vector<std::string>& files,
+                                    const SceneConfig& config, const std::string& basePath,
+                                    std::vector<std::string>& files,
                                     std::vector<std::string>& opacityMaps)
 {
-    std::unordered_map<std::string, u32> opacityMapIndices(files.size());
+    MemoryBudget memoryBudget(config.textureMemoryBudget);
+
+    TextureConversionContext context = {
+        .basePath = basePath,
+        .cacheDirectory = config.cacheDirectory,
+        .opacityMapIndices = std::unordered_map<std::string, u32>(files.size()),
+        .opacityMaps = opacityMaps,
+        .memoryBudget = memoryBudget,
+    };
 
     for (const auto& m : materials)
         if (m.opacityMap != INVALID_TEXTURE && m.albedoMap != INVALID_TEXTURE)
-            opacityMapIndices[files[m.albedoMap]] = (u32)m.opacityMap;
+            context.opacityMapIndices[files[m.albedoMap]] = (u32)m.opacityMap;
+
+    std::vector<TextureUsage> usages(files.size(), TextureUsage::Color);
+    for (const auto& m : materials)
+        if (m.normalMap != INVALID_TEXTURE)
+            usages[m.normalMap] = TextureUsage::Normal;
+
+    const u32 workerCount
+        = std::min<u32>((config.textureWorkerCount > 0)
+                            ? config.textureWorkerCount
+                            : std::max(std::thread::hardware_concurrency(), 1u),
+                        std::max<u32>((u32)files.size(), 1));
+
+    std::vector<TextureConversionStats> stats(files.size());
+    std::atomic<size_t> nextFile = 0;
 
-    auto converter = [&](const std::string& s) -> std::string {
-        return ConvertTexture(s, basePath, opacityMapIndices, opacityMaps);
+    const auto start = std::chrono::steady_clock::now();
+
+    auto worker = [&]() {
+        TextureScratch scratch;
+        for (size_t i = nextFile++; i < files.size(); i = nextFile++)
+            files[i] = ConvertTexture(files[i], usages[i], context, scratch, stats[i]);
     };
 
-    std::transform(std::execution::par, std::begin(files), std::end(files), std::begin(files),
-                   converter);
+    std::vector<std::thread> workers;
+    for (u32 i = 0; i < workerCount; i++)
+        workers.emplace_back(worker);
+    for (auto& thread : workers)
+        thread.join();
+
+    PrintTextureConversionReport(
+        stats, GetMilliseconds(start, std::chrono::steady_clock::now()),
+        memoryBudget.GetPeak(), workerCount);
 }
 
 static constexpr auto NUM_VERTEX_ELEMENTS = 3 + 3 + 2;
@@ -379,10 +810,14 @@ MaterialDescription ConvertAIMaterialToMaterialDescription(const aiMaterial* M,
     return matDescription;
 }
 
+/*
+ * outLodErrors receives the simplification error of every LOD relative to the mesh extents, see
+ * meshopt_simplifyScale. Each LOD is simplified from the previous one, so errors accumulate.
+ */
 void ProcessLods(std::vector<u32>& indices, std::vector<float>& vertices,
-                 std::vector<std::vector<u32>>& outLods)
+                 std::vector<std::vector<u32>>& outLods, std::vector<float>& outLodErrors)
 {
-    size_t verticesCountIn = vertices.size() / 2;
+    size_t verticesCountIn = vertices.size() / 3;
     size_t targetIndicesCount = indices.size();
 
     u8 LOD = 1;
@@ -390,16 +825,19 @@ void ProcessLods(std::vector<u32>& indices, std::vector<float>& vertices,
     LOG_INFO("processLods: indices count at the start ", indices.size());
 
     outLods.push_back(indices);
+    outLodErrors.push_back(0.0f);
 
-    while (targetIndicesCount > 1024 && LOD < 8)
+    // One lodOffset entry is needed as the end marker of the last LOD.
+    while (targetIndicesCount > 1024 && LOD < MAX_LODS - 1)
     {
         targetIndicesCount = indices.size() / 2;
 
         bool sloppy = false;
+        float error = 0.0f;
 
-        size_t numOptIndices
-            = meshopt_simplify(indices.data(), indices.data(), (u32)indices.size(), vertices.data(),
-                               verticesCountIn, sizeof(float) * 3, targetIndicesCount, 0.02f);
+        size_t numOptIndices = meshopt_simplify(
+            indices.data(), indices.data(), (u32)indices.size(), vertices.data(), verticesCountIn,
+            sizeof(float) * 3, targetIndicesCount, 0.02f, 0, &error);
 
         // cannot simplify further
         if (static_cast<size_t>(numOptIndices * 1.1f) > indices.size())
@@ -409,7 +847,7 @@ void ProcessLods(std::vector<u32>& indices, std::vector<float>& vertices,
                 // try harder
                 numOptIndices = meshopt_simplifySloppy(
                     indices.data(), indices.data(), indices.size(), vertices.data(),
-                    verticesCountIn, sizeof(float) * 3, targetIndicesCount, 0.02f, nullptr);
+                    verticesCountIn, sizeof(float) * 3, targetIndicesCount, 0.02f, &error);
                 sloppy = true;
                 if (numOptIndices == indices.size())
                     break;
@@ -424,30 +862,330 @@ void ProcessLods(std::vector<u32>& indices, std::vector<float>& vertices,
                                     verticesCountIn);
 
         LOG_INFO("ProcessLods: count of indices at LOD ", LOD, ": ", numOptIndices,
-                 ", sloppy:", sloppy);
+                 ", sloppy:", sloppy, ", error: ", error);
 
         LOD++;
 
         outLods.push_back(indices);
+        outLodErrors.push_back(outLodErrors.back() + error);
+    }
+};
+
+void ProcessMeshlets(const std::vector<u32>& indices, const std::vector<vec3>& positions,
+                     MeshData& meshData, Mesh& mesh)
+{
+    mesh.meshletOffset = (u32)meshData.meshlets.size();
+    mesh.meshletCount = 0;
+
+    if (indices.empty())
+        return;
+
+    const size_t maxMeshlets
+        = meshopt_buildMeshletsBound(indices.size(), MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+    std::vector<meshopt_Meshlet> meshlets(maxMeshlets);
+    std::vector<u32> meshletVertices(maxMeshlets * MESHLET_MAX_VERTICES);
+    std::vector<u8> meshletTriangles(maxMeshlets * MESHLET_MAX_TRIANGLES * 3);
+
+    const size_t meshletCount = meshopt_buildMeshlets(
+        meshlets.data(), meshletVertices.data(), meshletTriangles.data(), indices.data(),
+        indices.size(), &positions[0].x, positions.size(), sizeof(vec3), MESHLET_MAX_VERTICES,
+        MESHLET_MAX_TRIANGLES, 0.25f);
+
+    // Meshlet offsets are local to this mesh, rebase them onto the shared pools.
+    const u32 vertexBase = (u32)meshData.meshletVertices.size();
+    const u32 triangleBase = (u32)meshData.meshletTriangles.size();
+
+    for (size_t i = 0; i < meshletCount; i++)
+    {
+        const auto& meshlet = meshlets[i];
+        const auto bounds = meshopt_computeMeshletBounds(
+            &meshletVertices[meshlet.vertex_offset], &meshletTriangles[meshlet.triangle_offset],
+            meshlet.triangle_count, &positions[0].x, positions.size(), sizeof(vec3));
+
+        meshData.meshlets.push_back(Meshlet{
+            .vertexOffset = vertexBase + meshlet.vertex_offset,
+            .triangleOffset = triangleBase + meshlet.triangle_offset,
+            .vertexCount = meshlet.vertex_count,
+            .triangleCount = meshlet.triangle_count,
+        });
+        meshData.meshletBounds.push_back(MeshletBounds{
+            .center = vec3(bounds.center[0], bounds.center[1], bounds.center[2]),
+            .radius = bounds.radius,
+            .coneApex = vec3(bounds.cone_apex[0], bounds.cone_apex[1], bounds.cone_apex[2]),
+            .coneAxis = vec3(bounds.cone_axis[0], bounds.cone_axis[1], bounds.cone_axis[2]),
+            .coneCutoff = bounds.cone_cutoff,
+        });
+    }
+
+    if (meshletCount > 0)
+    {
+        // Triangle offsets of each meshlet are padded to 4 bytes.
+        const auto& last = meshlets[meshletCount - 1];
+        meshData.meshletVertices.insert(meshData.meshletVertices.end(), meshletVertices.begin(),
+                                        meshletVertices.begin() + last.vertex_offset
+                                            + last.vertex_count);
+        meshData.meshletTriangles.insert(meshData.meshletTriangles.end(), meshletTriangles.begin(),
+                                         meshletTriangles.begin() + last.triangle_offset
+                                             + ((last.triangle_count * 3 + 3) & ~3u));
+    }
+
+    mesh.meshletCount = (u32)meshletCount;
+
+    LOG_INFO("ProcessMeshlets: ", meshletCount, " meshlets for ", indices.size() / 3,
+             " triangles");
+}
+
+/*
+ * Octahedral encoding of a unit vector, both components are in [-1, 1].
+ */
+vec2 OctahedralEncode(const vec3& n)
+{
+    const float l1Norm = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (l1Norm == 0.0f)
+        return vec2(0.0f);
+
+    vec2 result = vec2(n.x, n.y) / l1Norm;
+    if (n.z < 0.0f)
+    {
+        result = vec2((1.0f - std::abs(result.y)) * (result.x >= 0.0f ? 1.0f : -1.0f),
+                      (1.0f - std::abs(result.x)) * (result.y >= 0.0f ? 1.0f : -1.0f));
+    }
+
+    return result;
+}
+
+/*
+ * Vertex cache, vertex fetch and overdraw statistics, summed over meshes and LODs.
+ */
+struct MeshOptimizationStats
+{
+    u64 triangles{0};
+    u64 vertices{0};
+    u64 verticesTransformed{0};
+    u64 bytesFetched{0};
+    u64 pixelsCovered{0};
+    u64 pixelsShaded{0};
+
+    void Add(const MeshOptimizationStats& other)
+    {
+        triangles += other.triangles;
+        vertices += other.vertices;
+        verticesTransformed += other.verticesTransformed;
+        bytesFetched += other.bytesFetched;
+        pixelsCovered += other.pixelsCovered;
+        pixelsShaded += other.pixelsShaded;
+    }
+
+    // Average cache miss ratio, transformed vertices per triangle.
+    float GetACMR() const
+    {
+        return triangles ? (float)verticesTransformed / (float)triangles : 0.0f;
+    }
+
+    // Average transformed vertex ratio, transformed vertices per unique vertex.
+    float GetATVR() const
+    {
+        return vertices ? (float)verticesTransformed / (float)vertices : 0.0f;
+    }
+
+    float GetOverdraw() const
+    {
+        return pixelsCovered ? (float)pixelsShaded / (float)pixelsCovered : 0.0f;
     }
 };
 
+void AnalyzeMeshLods(const std::vector<std::vector<u32>>& lods, const std::vector<float>& vertices,
+                     size_t vertexSize, MeshOptimizationStats& stats)
+{
+    const size_t vertexCount = vertices.size() / 3;
+
+    for (const auto& indices : lods)
+    {
+        // Same cache parameters as meshopt_optimizeVertexCache assumes.
+        const auto cache
+            = meshopt_analyzeVertexCache(indices.data(), indices.size(), vertexCount, 16, 0, 0);
+        const auto fetch
+            = meshopt_analyzeVertexFetch(indices.data(), indices.size(), vertexCount, vertexSize);
+        const auto overdraw = meshopt_analyzeOverdraw(indices.data(), indices.size(),
+                                                      vertices.data(), vertexCount,
+                                                      sizeof(float) * 3);
+
+        // Unique vertices referenced by the LOD.
+        std::vector<bool> referenced(vertexCount, false);
+        for (const auto index : indices)
+            referenced[index] = true;
+
+        stats.triangles += indices.size() / 3;
+        stats.vertices += std::count(referenced.begin(), referenced.end(), true);
+        stats.verticesTransformed += cache.vertices_transformed;
+        stats.bytesFetched += fetch.bytes_fetched;
+        stats.pixelsCovered += overdraw.pixels_covered;
+        stats.pixelsShaded += overdraw.pixels_shaded;
+    }
+}
+
+/*
+ * Reorders the triangles of every LOD for the post-transform vertex cache and for less overdraw.
+ * Returns the vertex fetch remap table, old vertex index -> new vertex index, with ~0u for
+ * vertices no triangle references, or an empty table when vertices keep their order.
+ */
+std::vector<u32> OptimizeMeshLods(std::vector<std::vector<u32>>& lods,
+                                  const std::vector<float>& vertices, const SceneConfig& config)
+{
+    const size_t vertexCount = vertices.size() / 3;
+
+    for (auto& indices : lods)
+    {
+        if (config.optimizeVertexCache)
+            meshopt_optimizeVertexCache(indices.data(), indices.data(), indices.size(),
+                                        vertexCount);
+
+        // Overdraw optimization keeps the cache efficiency within the threshold.
+        if (config.optimizeOverdraw)
+            meshopt_optimizeOverdraw(indices.data(), indices.data(), indices.size(),
+                                     vertices.data(), vertexCount, sizeof(float) * 3,
+                                     config.overdrawThreshold);
+    }
+
+    std::vector<u32> remap;
+    if (!config.optimizeVertexFetch || lods.empty() || lods[0].empty())
+        return remap;
+
+    // Coarser LODs only reference vertices of LOD 0, its order decides the vertex order.
+    remap.resize(vertexCount);
+    meshopt_optimizeVertexFetchRemap(remap.data(), lods[0].data(), lods[0].size(), vertexCount);
+
+    for (auto& indices : lods)
+        meshopt_remapIndexBuffer(indices.data(), indices.data(), indices.size(), remap.data());
+
+    return remap;
+}
+
 Mesh ConvertAIMesh(const aiMesh* aimesh, const SceneConfig& config, MeshData& meshData,
-                   u32& indexOffset, u32& vertexOffset)
+                   MeshOptimizationStats& statsBefore, MeshOptimizationStats& statsAfter)
 {
     const bool hasTexCoords = aimesh->HasTextureCoords(0);
-    const u32 streamElementSize = static_cast<u32>(NUM_VERTEX_ELEMENTS * sizeof(float));
-
-    // Original data for LOD calculation
+    const bool use16BitIndices = config.allow16BitIndices && aimesh->mNumVertices <= 65536;
+    const u32 streamElementSize = config.quantizeVertices
+                                      ? static_cast<u32>(sizeof(QuantizedVertex))
+                                      : static_cast<u32>(NUM_VERTEX_ELEMENTS * sizeof(float));
+    const bool optimize
+        = config.optimizeVertexCache || config.optimizeOverdraw || config.optimizeVertexFetch;
+
+    // Original data for LOD calculation and mesh optimization.
     std::vector<float> srcVertices;
     std::vector<u32> srcIndices;
 
     std::vector<std::vector<u32>> outLods;
+    std::vector<float> outLodErrors;
+
+    srcVertices.reserve(aimesh->mNumVertices * 3);
+    for (auto i = 0; i != aimesh->mNumVertices; i++)
+    {
+        const aiVector3D v = aimesh->mVertices[i];
+        srcVertices.push_back(v.x);
+        srcVertices.push_back(v.y);
+        srcVertices.push_back(v.z);
+    }
+
+    for (auto i = 0; i != aimesh->mNumFaces; i++)
+    {
+        if (aimesh->mFaces[i].mNumIndices != 3)
+            continue;
+        for (auto j = 0; j != aimesh->mFaces[i].mNumIndices; j++)
+            srcIndices.push_back(aimesh->mFaces[i].mIndices[j]);
+    }
+
+    if (!config.calculateLODs)
+        outLods.push_back(srcIndices);
+    else
+        ProcessLods(srcIndices, srcVertices, outLods, outLodErrors);
+
+    // Store LOD errors as absolute distances in mesh space.
+    const float errorScale
+        = outLodErrors.empty() ? 0.0f
+                               : meshopt_simplifyScale(srcVertices.data(), srcVertices.size() / 3,
+                                                       sizeof(float) * 3)
+                                     * config.scale;
+
+    std::vector<u32> vertexRemap;
+    if (optimize)
+    {
+        AnalyzeMeshLods(outLods, srcVertices, streamElementSize, statsBefore);
+        vertexRemap = OptimizeMeshLods(outLods, srcVertices, config);
+
+        // Vertex fetch statistics are only meaningful on the reordered vertices.
+        std::vector<float> optimizedVertices = srcVertices;
+        if (!vertexRemap.empty())
+            meshopt_remapVertexBuffer(optimizedVertices.data(), srcVertices.data(),
+                                      srcVertices.size() / 3, sizeof(float) * 3,
+                                      vertexRemap.data());
+        AnalyzeMeshLods(outLods, optimizedVertices, streamElementSize, statsAfter);
+    }
+
+    // Vertices no triangle references are dropped by the vertex fetch remap.
+    u32 vertexCount = aimesh->mNumVertices;
+    if (!vertexRemap.empty())
+    {
+        vertexCount = 0;
+        for (const auto index : vertexRemap)
+            if (index != ~0u)
+                vertexCount = std::max(vertexCount, index + 1);
+    }
+
+    // Scaled positions for meshlet generation.
+    std::vector<vec3> positions;
+    if (config.buildMeshlets)
+        positions.resize(vertexCount);
 
     auto& vertices = meshData.vertexData;
+    const size_t vertexDataStart = vertices.size();
+    vertices.resize(vertexDataStart + vertexCount * streamElementSize / sizeof(float));
+
+    Mesh result = {
+        .streamCount = 1,
+        .indexOffset = use16BitIndices ? (u32)meshData.indexData16.size()
+                                       : (u32)meshData.indexData.size(),
+        .vertexOffset = static_cast<u32>(vertexDataStart * sizeof(float) / streamElementSize),
+        .vertexCount = vertexCount,
+        .streamOffset = {static_cast<u32>(vertexDataStart * sizeof(float))},
+        .streamElementSize = {streamElementSize},
+        .vertexFormat = config.quantizeVertices ? VertexFormat::Quantized : VertexFormat::Float,
+        .indexFormat = use16BitIndices ? IndexFormat::U16 : IndexFormat::U32,
+    };
+
+    for (size_t l = 0; l < outLodErrors.size(); l++)
+        result.lodError[l] = outLodErrors[l] * errorScale;
+
+    // Quantized positions are relative to the bounds of the mesh.
+    vec3 boundsMin(std::numeric_limits<float>::max());
+    vec3 boundsMax(std::numeric_limits<float>::lowest());
+    for (auto i = 0; i != aimesh->mNumVertices; i++)
+    {
+        const aiVector3D v = aimesh->mVertices[i];
+        boundsMin = glm::min(boundsMin, vec3(v.x, v.y, v.z) * config.scale);
+        boundsMax = glm::max(boundsMax, vec3(v.x, v.y, v.z) * config.scale);
+    }
+
+    if (config.quantizeVertices)
+    {
+        const vec3 extent = boundsMax - boundsMin;
+        const float scale = std::max(std::max(extent.x, extent.y), extent.z);
+
+        result.positionOffset[0] = boundsMin.x;
+        result.positionOffset[1] = boundsMin.y;
+        result.positionOffset[2] = boundsMin.z;
+        result.positionScale = (scale > 0.0f) ? scale : 1.0f;
+    }
+
+    u8* dst = reinterpret_cast<u8*>(vertices.data() + vertexDataStart);
 
     for (auto i = 0; i != aimesh->mNumVertices; i++)
     {
+        const u32 dstIndex = vertexRemap.empty() ? (u32)i : vertexRemap[i];
+        if (dstIndex == ~0u)
+            continue;
+
         // vertices
         const aiVector3D v = aimesh->mVertices[i];
 
@@ -457,72 +1195,410 @@ Mesh ConvertAIMesh(const aiMesh* aimesh, const SceneConfig& config, MeshData& me
         // texcoords
         const aiVector3D t = hasTexCoords ? aimesh->mTextureCoords[0][i] : aiVector3D();
 
-        if (config.calculateLODs)
+        const vec3 position = vec3(v.x, v.y, v.z) * config.scale;
+        const vec2 uv(t.x, 1.0f - t.y);
+
+        if (config.buildMeshlets)
+            positions[dstIndex] = position;
+
+        if (config.quantizeVertices)
         {
-            srcVertices.push_back(v.x);
-            srcVertices.push_back(v.y);
-            srcVertices.push_back(v.z);
+            const vec3 p = (position - boundsMin) / result.positionScale;
+            const vec2 normal = OctahedralEncode(vec3(n.x, n.y, n.z));
+
+            const QuantizedVertex vertex = {
+                .position = {(u16)meshopt_quantizeUnorm(p.x, 16),
+                             (u16)meshopt_quantizeUnorm(p.y, 16),
+                             (u16)meshopt_quantizeUnorm(p.z, 16), 0},
+                .uv = {meshopt_quantizeHalf(uv.x), meshopt_quantizeHalf(uv.y)},
+                .normal = {(i16)meshopt_quantizeSnorm(normal.x, 16),
+                           (i16)meshopt_quantizeSnorm(normal.y, 16)},
+            };
+            memcpy(dst + dstIndex * streamElementSize, &vertex, sizeof(vertex));
         }
+        else
+        {
+            const float vertex[NUM_VERTEX_ELEMENTS]
+                = {position.x, position.y, position.z, uv.x, uv.y, n.x, n.y, n.z};
+            memcpy(dst + dstIndex * streamElementSize, vertex, sizeof(vertex));
+        }
+    }
+
+    u32 numIndices = 0;
+    for (auto l = 0; l < outLods.size(); l++)
+    {
+        if (use16BitIndices)
+            meshData.indexData16.insert(meshData.indexData16.end(), outLods[l].begin(),
+                                        outLods[l].end());
+        else
+            meshData.indexData.insert(meshData.indexData.end(), outLods[l].begin(),
+                                      outLods[l].end());
+
+        result.lodOffset[l] = numIndices;
+        numIndices += (int)outLods[l].size();
+    }
+
+    result.lodOffset[outLods.size()] = numIndices;
+    result.lodCount = (u32)outLods.size();
+
+    if (config.buildMeshlets)
+        ProcessMeshlets(outLods[0], positions, meshData, result);
+
+    return result;
+}
 
-        vertices.push_back(v.x * config.scale);
-        vertices.push_back(v.y * config.scale);
-        vertices.push_back(v.z * config.scale);
+u64 HashAIMesh(const aiMesh* aimesh)
+{
+    u64 hash = HashValue(aimesh->mNumVertices);
+    hash = HashBytes(aimesh->mVertices, aimesh->mNumVertices * sizeof(aiVector3D), hash);
+    hash = HashBytes(aimesh->mNormals, aimesh->mNumVertices * sizeof(aiVector3D), hash);
 
-        vertices.push_back(t.x);
-        vertices.push_back(1.0f - t.y);
+    const bool hasTexCoords = aimesh->HasTextureCoords(0);
+    hash = HashValue(hasTexCoords, hash);
+    if (hasTexCoords)
+        hash = HashBytes(aimesh->mTextureCoords[0], aimesh->mNumVertices * sizeof(aiVector3D),
+                         hash);
 
-        vertices.push_back(n.x);
-        vertices.push_back(n.y);
-        vertices.push_back(n.z);
+    for (unsigned int i = 0; i != aimesh->mNumFaces; i++)
+    {
+        const auto& face = aimesh->mFaces[i];
+        hash = HashValue(face.mNumIndices, hash);
+        hash = HashBytes(face.mIndices, face.mNumIndices * sizeof(unsigned int), hash);
     }
 
-    Mesh result = {
-        .vertexCount = aimesh->mNumVertices,
-        .vertexOffset = vertexOffset,
-        .indexOffset = indexOffset,
-        .streamCount = 1,
-        .streamOffset = {vertexOffset * streamElementSize},
-        .streamElementSize = {streamElementSize},
+    return hash;
+}
+
+/*
+ * Hash of the SceneConfig fields that change the result of ConvertAIMesh.
+ */
+u64 HashMeshConversionParameters(const SceneConfig& config)
+{
+    u64 hash = HashValue(CONVERSION_CACHE_VERSION);
+    hash = HashCombine(hash, HashValue(MESH_FILE_VERSION));
+    hash = HashCombine(hash, HashValue(sizeof(Mesh)));
+    hash = HashCombine(hash, HashValue(config.scale));
+    hash = HashCombine(hash, HashValue(config.calculateLODs));
+    hash = HashCombine(hash, HashValue(config.quantizeVertices));
+    hash = HashCombine(hash, HashValue(config.allow16BitIndices));
+    hash = HashCombine(hash, HashValue(config.buildMeshlets));
+    hash = HashCombine(hash, HashValue(config.optimizeVertexCache));
+    hash = HashCombine(hash, HashValue(config.optimizeOverdraw));
+    hash = HashCombine(hash, HashValue(config.optimizeVertexFetch));
+    hash = HashCombine(hash, HashValue(config.overdrawThreshold));
+
+    return hash;
+}
+
+/*
+ * Converts the mesh into an empty meshData, or loads it from the conversion cache if the same
+ * source mesh was already converted with the same parameters. Returns true on a cache hit,
+ * optimization statistics are only gathered for meshes that are actually converted.
+ */
+bool ConvertAIMeshCached(const aiMesh* aimesh, const SceneConfig& config, u64 parametersHash,
+                         MeshData& meshData, MeshOptimizationStats& statsBefore,
+                         MeshOptimizationStats& statsAfter)
+{
+    std::string cacheFile;
+    if (!config.cacheDirectory.empty())
+    {
+        const u64 cacheKey = HashCombine(parametersHash, HashAIMesh(aimesh));
+        cacheFile = GetCacheFileName(config.cacheDirectory, "meshes", cacheKey, ".meshes");
+
+        if (fs::exists(cacheFile) && LoadMeshData(cacheFile, meshData).meshCount == 1)
+            return true;
+
+        meshData = MeshData();
+    }
+
+    meshData.meshes.push_back(ConvertAIMesh(aimesh, config, meshData, statsBefore, statsAfter));
+    RecalculateBoundingBoxes(meshData);
+
+    if (!cacheFile.empty())
+    {
+        const std::string tmpFile = GetCacheTempFileName(cacheFile);
+        std::error_code error;
+        bool stored = SaveMeshData(tmpFile, meshData);
+        if (stored)
+        {
+            fs::rename(tmpFile, cacheFile, error);
+            stored = !error;
+        }
+
+        if (!stored)
+            fs::remove(tmpFile, error);
+    }
+
+    return false;
+}
+
+/*
+ * Concatenates the pools of all parts into one MeshData. Destination offsets of every part are
+ * the prefix sums of the pool sizes of the parts before it, so the result is the same as
+ * converting all meshes serially into a single MeshData.
+ */
+MeshData MergeMeshData(std::vector<MeshData>& parts)
+{
+    struct PartOffsets
+    {
+        size_t meshes{0};
+        size_t boundingBoxes{0};
+        size_t vertexData{0};
+        size_t indexData{0};
+        size_t indexData16{0};
+        size_t meshlets{0};
+        size_t meshletVertices{0};
+        size_t meshletTriangles{0};
     };
 
-    for (auto i = 0; i != aimesh->mNumFaces; i++)
+    // One extra entry holding the total sizes.
+    std::vector<PartOffsets> offsets(parts.size() + 1);
+    for (size_t i = 0; i < parts.size(); i++)
     {
-        if (aimesh->mFaces[i].mNumIndices != 3)
-            continue;
-        for (auto j = 0; j != aimesh->mFaces[i].mNumIndices; j++)
-            srcIndices.push_back(aimesh->mFaces[i].mIndices[j]);
+        const auto& part = parts[i];
+        const auto& prev = offsets[i];
+        offsets[i + 1] = {
+            .meshes = prev.meshes + part.meshes.size(),
+            .boundingBoxes = prev.boundingBoxes + part.boundingBoxes.size(),
+            .vertexData = prev.vertexData + part.vertexData.size(),
+            .indexData = prev.indexData + part.indexData.size(),
+            .indexData16 = prev.indexData16 + part.indexData16.size(),
+            .meshlets = prev.meshlets + part.meshlets.size(),
+            .meshletVertices = prev.meshletVertices + part.meshletVertices.size(),
+            .meshletTriangles = prev.meshletTriangles + part.meshletTriangles.size(),
+        };
     }
 
-    if (!config.calculateLODs)
-        outLods.push_back(srcIndices);
+    const auto& total = offsets.back();
+
+    MeshData result;
+    result.meshes.resize(total.meshes);
+    result.boundingBoxes.resize(total.boundingBoxes);
+    result.vertexData.resize(total.vertexData);
+    result.indexData.resize(total.indexData);
+    result.indexData16.resize(total.indexData16);
+    result.meshlets.resize(total.meshlets);
+    result.meshletBounds.resize(total.meshlets);
+    result.meshletVertices.resize(total.meshletVertices);
+    result.meshletTriangles.resize(total.meshletTriangles);
+
+    std::vector<size_t> partIndices(parts.size());
+    std::iota(partIndices.begin(), partIndices.end(), 0);
+
+    std::for_each(std::execution::par, partIndices.begin(), partIndices.end(), [&](size_t i) {
+        auto& part = parts[i];
+        const auto& base = offsets[i];
+
+        for (size_t m = 0; m < part.meshes.size(); m++)
+        {
+            Mesh mesh = part.meshes[m];
+            mesh.streamOffset[0] += (u32)(base.vertexData * sizeof(float));
+            mesh.vertexOffset = mesh.streamOffset[0] / mesh.streamElementSize[0];
+            mesh.indexOffset += (u32)((mesh.indexFormat == IndexFormat::U16) ? base.indexData16
+                                                                              : base.indexData);
+            mesh.meshletOffset += (u32)base.meshlets;
+            result.meshes[base.meshes + m] = mesh;
+        }
+
+        for (size_t m = 0; m < part.meshlets.size(); m++)
+        {
+            Meshlet meshlet = part.meshlets[m];
+            meshlet.vertexOffset += (u32)base.meshletVertices;
+            meshlet.triangleOffset += (u32)base.meshletTriangles;
+            result.meshlets[base.meshlets + m] = meshlet;
+        }
+
+        std::copy(part.boundingBoxes.begin(), part.boundingBoxes.end(),
+                  result.boundingBoxes.begin() + base.boundingBoxes);
+        std::copy(part.vertexData.begin(), part.vertexData.end(),
+                  result.vertexData.begin() + base.vertexData);
+        std::copy(part.indexData.begin(), part.indexData.end(),
+                  result.indexData.begin() + base.indexData);
+        std::copy(part.indexData16.begin(), part.indexData16.end(),
+                  result.indexData16.begin() + base.indexData16);
+        std::copy(part.meshletBounds.begin(), part.meshletBounds.end(),
+                  result.meshletBounds.begin() + base.meshlets);
+        std::copy(part.meshletVertices.begin(), part.meshletVertices.end(),
+                  result.meshletVertices.begin() + base.meshletVertices);
+        std::copy(part.meshletTriangles.begin(), part.meshletTriangles.end(),
+                  result.meshletTriangles.begin() + base.meshletTriangles);
+
+        part = MeshData();
+    });
+
+    return result;
+}
+
+std::span<const u8> GetMeshVertexBytes(const MeshData& meshData, const Mesh& mesh)
+{
+    return {reinterpret_cast<const u8*>(meshData.vertexData.data()) + mesh.streamOffset[0],
+            (size_t)mesh.vertexCount * mesh.streamElementSize[0]};
+}
+
+std::span<const u8> GetMeshIndexBytes(const MeshData& meshData, const Mesh& mesh)
+{
+    const size_t indexCount = mesh.lodOffset[mesh.lodCount];
+    if (mesh.indexFormat == IndexFormat::U16)
+        return {reinterpret_cast<const u8*>(meshData.indexData16.data() + mesh.indexOffset),
+                indexCount * sizeof(u16)};
+
+    return {reinterpret_cast<const u8*>(meshData.indexData.data() + mesh.indexOffset),
+            indexCount * sizeof(u32)};
+}
+
+/*
+ * Mesh fields that do not depend on where the mesh data lives in MeshData.
+ */
+bool HasSameLayout(const Mesh& a, const Mesh& b)
+{
+    return a.vertexCount == b.vertexCount && a.lodCount == b.lodCount
+           && std::equal(a.lodOffset, a.lodOffset + MAX_LODS, b.lodOffset)
+           && a.streamElementSize[0] == b.streamElementSize[0] && a.vertexFormat == b.vertexFormat
+           && a.indexFormat == b.indexFormat
+           && memcmp(a.positionOffset, b.positionOffset, sizeof(a.positionOffset)) == 0
+           && a.positionScale == b.positionScale;
+}
+
+u64 HashMesh(const MeshData& meshData, const Mesh& mesh)
+{
+    const auto vertices = GetMeshVertexBytes(meshData, mesh);
+    const auto indices = GetMeshIndexBytes(meshData, mesh);
+
+    u64 hash = HashBytes(vertices.data(), vertices.size());
+    hash = HashCombine(hash, HashBytes(indices.data(), indices.size()));
+    hash = HashCombine(hash, HashValue(mesh.vertexCount));
+    hash = HashCombine(hash, HashValue(mesh.lodOffset));
+
+    return hash;
+}
+
+/*
+ * Copies the data of the mesh to the end of the pools of dst and returns the rebased mesh.
+ */
+Mesh AppendMesh(MeshData& dst, const MeshData& src, const Mesh& mesh)
+{
+    Mesh result = mesh;
+
+    const auto vertices = GetMeshVertexBytes(src, mesh);
+    result.streamOffset[0] = (u32)(dst.vertexData.size() * sizeof(float));
+    result.vertexOffset = (u32)(result.streamOffset[0] / mesh.streamElementSize[0]);
+    dst.vertexData.resize(dst.vertexData.size() + vertices.size() / sizeof(float));
+    memcpy(reinterpret_cast<u8*>(dst.vertexData.data()) + result.streamOffset[0], vertices.data(),
+           vertices.size());
+
+    const size_t indexCount = mesh.lodOffset[mesh.lodCount];
+    if (mesh.indexFormat == IndexFormat::U16)
+    {
+        result.indexOffset = (u32)dst.indexData16.size();
+        dst.indexData16.insert(dst.indexData16.end(),
+                               src.indexData16.begin() + mesh.indexOffset,
+                               src.indexData16.begin() + mesh.indexOffset + indexCount);
+    }
     else
-        ProcessLods(srcIndices, srcVertices, outLods);
+    {
+        result.indexOffset = (u32)dst.indexData.size();
+        dst.indexData.insert(dst.indexData.end(), src.indexData.begin() + mesh.indexOffset,
+                             src.indexData.begin() + mesh.indexOffset + indexCount);
+    }
 
-    u32 numIndices = 0;
-    for (auto l = 0; l < outLods.size(); l++)
+    result.meshletOffset = (u32)dst.meshlets.size();
+    if (mesh.meshletCount > 0)
     {
-        for (auto i = 0; i < outLods[l].size(); i++)
-            meshData.indexData.push_back(outLods[l][i]);
+        const auto& first = src.meshlets[mesh.meshletOffset];
+        const auto& last = src.meshlets[mesh.meshletOffset + mesh.meshletCount - 1];
+        const u32 vertexBase = (u32)dst.meshletVertices.size();
+        const u32 triangleBase = (u32)dst.meshletTriangles.size();
 
-        result.lodOffset[l] = numIndices;
-        numIndices += (int)outLods[l].size();
+        for (u32 i = 0; i < mesh.meshletCount; i++)
+        {
+            Meshlet meshlet = src.meshlets[mesh.meshletOffset + i];
+            meshlet.vertexOffset = meshlet.vertexOffset - first.vertexOffset + vertexBase;
+            meshlet.triangleOffset = meshlet.triangleOffset - first.triangleOffset + triangleBase;
+            dst.meshlets.push_back(meshlet);
+            dst.meshletBounds.push_back(src.meshletBounds[mesh.meshletOffset + i]);
+        }
+
+        dst.meshletVertices.insert(dst.meshletVertices.end(),
+                                   src.meshletVertices.begin() + first.vertexOffset,
+                                   src.meshletVertices.begin() + last.vertexOffset
+                                       + last.vertexCount);
+        dst.meshletTriangles.insert(dst.meshletTriangles.end(),
+                                    src.meshletTriangles.begin() + first.triangleOffset,
+                                    src.meshletTriangles.begin() + last.triangleOffset
+                                        + ((last.triangleCount * 3 + 3) & ~3u));
     }
 
-    result.lodOffset[outLods.size()] = numIndices;
-    result.lodCount = (u32)outLods.size();
+    return result;
+}
 
-    indexOffset += numIndices;
-    vertexOffset += aimesh->mNumVertices;
+/*
+ * Collapses meshes with identical vertex and index data into one. Returns the new index of every
+ * original mesh.
+ */
+std::vector<u32> MergeDuplicateMeshes(MeshData& meshData)
+{
+    std::vector<u32> remap(meshData.meshes.size());
 
-    return result;
+    MeshData merged;
+    merged.meshes.reserve(meshData.meshes.size());
+
+    // Mesh hash -> indices of the merged meshes with that hash.
+    std::unordered_map<u64, std::vector<u32>> uniqueMeshes;
+
+    for (size_t i = 0; i < meshData.meshes.size(); i++)
+    {
+        const auto& mesh = meshData.meshes[i];
+        auto& candidates = uniqueMeshes[HashMesh(meshData, mesh)];
+
+        const auto duplicate
+            = std::find_if(candidates.begin(), candidates.end(), [&](u32 candidate) {
+                  const auto& other = merged.meshes[candidate];
+                  return HasSameLayout(mesh, other)
+                         && std::ranges::equal(GetMeshVertexBytes(meshData, mesh),
+                                               GetMeshVertexBytes(merged, other))
+                         && std::ranges::equal(GetMeshIndexBytes(meshData, mesh),
+                                               GetMeshIndexBytes(merged, other));
+              });
+
+        if (duplicate != candidates.end())
+        {
+            remap[i] = *duplicate;
+            continue;
+        }
+
+        remap[i] = (u32)merged.meshes.size();
+        candidates.push_back(remap[i]);
+        merged.meshes.push_back(AppendMesh(merged, meshData, mesh));
+    }
+
+    LOG_INFO("MergeDuplicateMeshes: ", meshData.meshes.size(), " meshes merged into ",
+             merged.meshes.size(), ", vertex data ", meshData.vertexData.size() * sizeof(float),
+             " -> ", merged.vertexData.size() * sizeof(float), " bytes");
+
+    meshData = std::move(merged);
+
+    return remap;
 }
 
-void ProcessScene(const SceneConfig& config)
+void PrintOptimizationReport(const std::vector<MeshOptimizationStats>& statsBefore,
+                             const std::vector<MeshOptimizationStats>& statsAfter)
 {
-    MeshData meshData;
-    u32 indexOffset = 0;
-    u32 vertexOffset = 0;
+    MeshOptimizationStats before;
+    MeshOptimizationStats after;
+    for (const auto& stats : statsBefore)
+        before.Add(stats);
+    for (const auto& stats : statsAfter)
+        after.Add(stats);
+
+    LOG_INFO("Mesh optimization: ", before.triangles, " triangles over all LODs");
+    LOG_INFO("  ACMR:          ", before.GetACMR(), " -> ", after.GetACMR());
+    LOG_INFO("  ATVR:          ", before.GetATVR(), " -> ", after.GetATVR());
+    LOG_INFO("  Overdraw:      ", before.GetOverdraw(), " -> ", after.GetOverdraw());
+    LOG_INFO("  Bytes fetched: ", before.bytesFetched, " -> ", after.bytesFetched);
+}
 
+void ProcessScene(const SceneConfig& config)
+{
     const std::size_t pathSeparator = config.fileName.find_last_of("/\\");
     const std::string basePath = (pathSeparator != std::string::npos)
                                      ? config.fileName.substr(0, pathSeparator + 1)
@@ -545,20 +1621,50 @@ void ProcessScene(const SceneConfig& config)
         exit(EXIT_FAILURE);
     }
 
-    // 1. Mesh conversion.
-    meshData.meshes.reserve(scene->mNumMeshes);
-    meshData.boundingBoxes.reserve(scene->mNumMeshes);
+    // 1. Mesh conversion. Every mesh is converted into its own MeshData in parallel, then all of
+    // them are stitched together in source order.
+    std::vector<MeshData> meshParts(scene->mNumMeshes);
+    std::vector<MeshOptimizationStats> statsBefore(scene->mNumMeshes);
+    std::vector<MeshOptimizationStats> statsAfter(scene->mNumMeshes);
+    std::vector<unsigned int> meshIndices(scene->mNumMeshes);
+    std::iota(meshIndices.begin(), meshIndices.end(), 0);
 
-    for (unsigned int i = 0; i != scene->mNumMeshes; i++)
+    if (!config.cacheDirectory.empty())
     {
-        LOG_INFO("Converting meshes,  ", i + 1, "/", scene->mNumMeshes, "...");
-        Mesh mesh = ConvertAIMesh(scene->mMeshes[i], config, meshData, indexOffset, vertexOffset);
-        meshData.meshes.push_back(mesh);
+        fs::create_directories(config.cacheDirectory + "/meshes");
+        fs::create_directories(config.cacheDirectory + "/textures");
     }
 
+    const u64 parametersHash = HashMeshConversionParameters(config);
+    std::atomic<u32> cachedMeshCount = 0;
+
+    std::for_each(std::execution::par, meshIndices.begin(), meshIndices.end(),
+                  [&](unsigned int i) {
+                      LOG_INFO("Converting mesh ", i + 1, "/", scene->mNumMeshes, "...");
+                      if (ConvertAIMeshCached(scene->mMeshes[i], config, parametersHash,
+                                              meshParts[i], statsBefore[i], statsAfter[i]))
+                          cachedMeshCount++;
+                  });
+
+    if (!config.cacheDirectory.empty())
+        LOG_INFO(cachedMeshCount.load(), "/", scene->mNumMeshes,
+                 " meshes loaded from the conversion cache");
+
+    if (config.optimizeVertexCache || config.optimizeOverdraw || config.optimizeVertexFetch)
+        PrintOptimizationReport(statsBefore, statsAfter);
+
+    MeshData meshData = MergeMeshData(meshParts);
+
+    // Scene nodes reference meshes through this, source mesh index -> converted mesh index.
+    std::vector<u32> meshRemap(meshData.meshes.size());
+    if (config.mergeInstances)
+        meshRemap = MergeDuplicateMeshes(meshData);
+    else
+        std::iota(meshRemap.begin(), meshRemap.end(), 0);
+
     RecalculateBoundingBoxes(meshData);
 
-    SaveMeshData(config.outputMesh.c_str(), meshData);
+    SaveMeshData(config.outputMesh.c_str(), meshData, config.compressMeshes);
 
     Scene ourScene;
 
@@ -581,12 +1687,17 @@ void ProcessScene(const SceneConfig& config)
     }
 
     // 3. Texture processing, rescaling and packing.
-    ConvertAndDownscaleAllTextures(materials, basePath, files, opacityMaps);
+    ConvertAndDownscaleAllTextures(materials, config, basePath, files, opacityMaps);
 
     SaveMaterials(config.outputMaterials, materials, files);
 
     // 4. Scene hierarchy conversion.
-    Traverse(scene, ourScene, scene->mRootNode, -1, 0);
+    Traverse(scene, ourScene, scene->mRootNode, -1, 0, meshRemap);
+    SortSceneByDepth(ourScene);
+
+    // Node transforms with shear keep the full matrices.
+    if (config.storeTRSTransforms && !ConvertToTRSLocalTransforms(ourScene))
+        LOG_WARN("Scene ", config.fileName, " has non TRS node transforms");
 
     SaveScene(config.outputScene, ourScene);
 }
@@ -604,7 +1715,13 @@ int main()
             .outputMaterials = "../Resources/Bistro/exterior.materials",
             .scale = 0.01,
             .calculateLODs = false,
-            .mergeInstances = false,
+            .mergeInstances = true,
+            .compressMeshes = true,
+            .quantizeVertices = true,
+            .allow16BitIndices = true,
+            .buildMeshlets = true,
+            .storeTRSTransforms = true,
+            .cacheDirectory = "../Resources/Bistro/ConversionCache",
         },
         /* {
              .fileName = "../../../../../Resources/bistro/Interior/interior.obj",
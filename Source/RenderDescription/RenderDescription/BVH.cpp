@@ -0,0 +1,431 @@
+#include "BVH.h"
+
+#include <Core/MathSIMD.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <numeric>
+
+namespace Nerine
+{
+
+namespace
+{
+
+constexpr u32 BVH_BIN_COUNT = 16;
+constexpr u32 BVH_MAX_LEAF_ITEMS = 8;
+
+// Cost of visiting a node relative to testing one item.
+constexpr float BVH_TRAVERSAL_COST = 1.0f;
+
+BoundingBox GetEmptyBox()
+{
+    BoundingBox box;
+    box.min = vec3(std::numeric_limits<float>::max());
+    box.max = vec3(std::numeric_limits<float>::lowest());
+    return box;
+}
+
+void Grow(BoundingBox& box, const BoundingBox& other)
+{
+    box.CombinePoint(other.min);
+    box.CombinePoint(other.max);
+}
+
+// Half the surface area, only the ratios matter for the SAH.
+float GetHalfArea(const BoundingBox& box)
+{
+    const vec3 size = box.max - box.min;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+struct BVHBin
+{
+    BoundingBox bounds{GetEmptyBox()};
+    u32 count{0};
+};
+
+/*
+ * Frustum planes in SoA layout for testing a box against four planes at once, padded to eight
+ * with planes that contain everything. Boxes are also tested against the bounds of the frustum
+ * corners, which is the corner part of IsBoxInFrustum.
+ */
+struct FrustumTest
+{
+    alignas(16) float x[8];
+    alignas(16) float y[8];
+    alignas(16) float z[8];
+    alignas(16) float w[8];
+
+    vec3 cornersMin;
+    vec3 cornersMax;
+};
+
+FrustumTest CreateFrustumTest(const vec4* frustumPlanes, const vec4* frustumCorners)
+{
+    FrustumTest test;
+    for (u32 i = 0; i < 8; i++)
+    {
+        const vec4 plane = (i < 6) ? frustumPlanes[i] : vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        test.x[i] = plane.x;
+        test.y[i] = plane.y;
+        test.z[i] = plane.z;
+        test.w[i] = plane.w;
+    }
+
+    test.cornersMin = vec3(frustumCorners[0]);
+    test.cornersMax = vec3(frustumCorners[0]);
+    for (u32 i = 1; i < 8; i++)
+    {
+        test.cornersMin = glm::min(test.cornersMin, vec3(frustumCorners[i]));
+        test.cornersMax = glm::max(test.cornersMax, vec3(frustumCorners[i]));
+    }
+
+    return test;
+}
+
+enum class FrustumTestResult
+{
+    OUTSIDE,
+    INTERSECTING,
+    INSIDE,
+};
+
+/*
+ * Per plane, the box corner furthest along the plane normal decides whether the box is outside
+ * and the nearest one whether it is inside. The sums follow glm's dot product, (x + y) + (z + w),
+ * so boxes are rejected exactly like in IsBoxInFrustum.
+ */
+FrustumTestResult TestBox(const FrustumTest& test, const BoundingBox& box)
+{
+    if (box.max.x < test.cornersMin.x || box.min.x > test.cornersMax.x
+        || box.max.y < test.cornersMin.y || box.min.y > test.cornersMax.y
+        || box.max.z < test.cornersMin.z || box.min.z > test.cornersMax.z)
+        return FrustumTestResult::OUTSIDE;
+
+    bool inside = true;
+
+#ifdef NERINE_SIMD_SSE
+    const __m128 minX = _mm_set1_ps(box.min.x);
+    const __m128 minY = _mm_set1_ps(box.min.y);
+    const __m128 minZ = _mm_set1_ps(box.min.z);
+    const __m128 maxX = _mm_set1_ps(box.max.x);
+    const __m128 maxY = _mm_set1_ps(box.max.y);
+    const __m128 maxZ = _mm_set1_ps(box.max.z);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (u32 i = 0; i < 8; i += 4)
+    {
+        const __m128 px = _mm_load_ps(test.x + i);
+        const __m128 py = _mm_load_ps(test.y + i);
+        const __m128 pz = _mm_load_ps(test.z + i);
+        const __m128 pw = _mm_load_ps(test.w + i);
+
+        const __m128 x0 = _mm_mul_ps(px, minX);
+        const __m128 x1 = _mm_mul_ps(px, maxX);
+        const __m128 y0 = _mm_mul_ps(py, minY);
+        const __m128 y1 = _mm_mul_ps(py, maxY);
+        const __m128 z0 = _mm_mul_ps(pz, minZ);
+        const __m128 z1 = _mm_mul_ps(pz, maxZ);
+
+        const __m128 far = _mm_add_ps(_mm_add_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+                                      _mm_add_ps(_mm_max_ps(z0, z1), pw));
+        if (_mm_movemask_ps(_mm_cmplt_ps(far, zero)) != 0)
+            return FrustumTestResult::OUTSIDE;
+
+        const __m128 near = _mm_add_ps(_mm_add_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+                                       _mm_add_ps(_mm_min_ps(z0, z1), pw));
+        inside = inside && _mm_movemask_ps(_mm_cmplt_ps(near, zero)) == 0;
+    }
+#else
+    for (u32 i = 0; i < 6; i++)
+    {
+        const float x0 = test.x[i] * box.min.x;
+        const float x1 = test.x[i] * box.max.x;
+        const float y0 = test.y[i] * box.min.y;
+        const float y1 = test.y[i] * box.max.y;
+        const float z0 = test.z[i] * box.min.z;
+        const float z1 = test.z[i] * box.max.z;
+
+        const float far = (std::max(x0, x1) + std::max(y0, y1)) + (std::max(z0, z1) + test.w[i]);
+        if (far < 0.0f)
+            return FrustumTestResult::OUTSIDE;
+
+        const float near
+            = (std::min(x0, x1) + std::min(y0, y1)) + (std::min(z0, z1) + test.w[i]);
+        inside = inside && near >= 0.0f;
+    }
+#endif
+
+    return inside ? FrustumTestResult::INSIDE : FrustumTestResult::INTERSECTING;
+}
+
+} // namespace
+
+void BVH::Build(std::span<const BoundingBox> boxes)
+{
+    const u32 itemCount = (u32)boxes.size();
+
+    m_Nodes.clear();
+    m_Parents.clear();
+    m_Items.resize(itemCount);
+    std::iota(m_Items.begin(), m_Items.end(), 0);
+
+    if (itemCount == 0)
+    {
+        m_ItemBoxes.clear();
+        m_ItemSlots.clear();
+        m_ItemLeaves.clear();
+        m_DirtyNodes.clear();
+        return;
+    }
+
+    std::vector<vec3> centroids(itemCount);
+    BoundingBox rootBounds = GetEmptyBox();
+    for (u32 i = 0; i < itemCount; i++)
+    {
+        centroids[i] = boxes[i].GetCenter();
+        Grow(rootBounds, boxes[i]);
+    }
+
+    m_Nodes.reserve(2 * itemCount);
+    m_Nodes.push_back({rootBounds, 0, itemCount, 0});
+    m_Parents.reserve(2 * itemCount);
+    m_Parents.push_back(u32(-1));
+
+    std::vector<u32> stack = {0};
+    while (!stack.empty())
+    {
+        const u32 nodeIndex = stack.back();
+        stack.pop_back();
+
+        const BVHNode node = m_Nodes[nodeIndex];
+        if (node.itemCount == 1)
+            continue;
+
+        const auto itemsBegin = m_Items.begin() + node.firstItem;
+        const auto itemsEnd = itemsBegin + node.itemCount;
+
+        BoundingBox centroidBounds = GetEmptyBox();
+        for (auto item = itemsBegin; item != itemsEnd; item++)
+            centroidBounds.CombinePoint(centroids[*item]);
+
+        // Best split over all axes, items in bins [0, bestBin] go to the left child.
+        float bestCost = std::numeric_limits<float>::max();
+        u32 bestAxis = 0;
+        u32 bestBin = 0;
+        BoundingBox bestLeftBounds;
+        BoundingBox bestRightBounds;
+
+        for (u32 axis = 0; axis < 3; axis++)
+        {
+            const float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+            if (extent <= 0.0f)
+                continue;
+
+            const float scale = BVH_BIN_COUNT / extent;
+            BVHBin bins[BVH_BIN_COUNT];
+            for (auto item = itemsBegin; item != itemsEnd; item++)
+            {
+                const u32 bin = std::min(
+                    BVH_BIN_COUNT - 1,
+                    (u32)((centroids[*item][axis] - centroidBounds.min[axis]) * scale));
+                Grow(bins[bin].bounds, boxes[*item]);
+                bins[bin].count++;
+            }
+
+            // Right side of every split, then sweep the left side.
+            BoundingBox rightBounds[BVH_BIN_COUNT];
+            u32 rightCounts[BVH_BIN_COUNT];
+            BoundingBox bounds = GetEmptyBox();
+            u32 count = 0;
+            for (u32 bin = BVH_BIN_COUNT - 1; bin > 0; bin--)
+            {
+                Grow(bounds, bins[bin].bounds);
+                count += bins[bin].count;
+                rightBounds[bin - 1] = bounds;
+                rightCounts[bin - 1] = count;
+            }
+
+            bounds = GetEmptyBox();
+            count = 0;
+            for (u32 bin = 0; bin < BVH_BIN_COUNT - 1; bin++)
+            {
+                Grow(bounds, bins[bin].bounds);
+                count += bins[bin].count;
+                if (count == 0 || rightCounts[bin] == 0)
+                    continue;
+
+                const float cost = GetHalfArea(bounds) * count
+                                   + GetHalfArea(rightBounds[bin]) * rightCounts[bin];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = bin;
+                    bestLeftBounds = bounds;
+                    bestRightBounds = rightBounds[bin];
+                }
+            }
+        }
+
+        u32 leftCount = 0;
+        if (bestCost < std::numeric_limits<float>::max())
+        {
+            const float leafCost = (float)node.itemCount;
+            const float splitCost
+                = BVH_TRAVERSAL_COST + bestCost / std::max(GetHalfArea(node.bounds), 1e-20f);
+            if (splitCost >= leafCost && node.itemCount <= BVH_MAX_LEAF_ITEMS)
+                continue;
+
+            const float scale = BVH_BIN_COUNT / (centroidBounds.max[bestAxis]
+                                                 - centroidBounds.min[bestAxis]);
+            const auto split = std::partition(itemsBegin, itemsEnd, [&](u32 item) {
+                const u32 bin = std::min(
+                    BVH_BIN_COUNT - 1,
+                    (u32)((centroids[item][bestAxis] - centroidBounds.min[bestAxis]) * scale));
+                return bin <= bestBin;
+            });
+            leftCount = (u32)(split - itemsBegin);
+        }
+        else
+        {
+            // All centroids are equal, no split separates them.
+            if (node.itemCount <= BVH_MAX_LEAF_ITEMS)
+                continue;
+
+            leftCount = node.itemCount / 2;
+            bestLeftBounds = GetEmptyBox();
+            bestRightBounds = GetEmptyBox();
+            for (u32 i = 0; i < node.itemCount; i++)
+                Grow((i < leftCount) ? bestLeftBounds : bestRightBounds, boxes[itemsBegin[i]]);
+        }
+
+        const u32 leftChild = (u32)m_Nodes.size();
+        m_Nodes[nodeIndex].leftChild = leftChild;
+        m_Nodes.push_back({bestLeftBounds, node.firstItem, leftCount, 0});
+        m_Nodes.push_back(
+            {bestRightBounds, node.firstItem + leftCount, node.itemCount - leftCount, 0});
+        m_Parents.push_back(nodeIndex);
+        m_Parents.push_back(nodeIndex);
+
+        stack.push_back(leftChild + 1);
+        stack.push_back(leftChild);
+    }
+
+    m_ItemBoxes.resize(itemCount);
+    m_ItemSlots.resize(itemCount);
+    for (u32 slot = 0; slot < itemCount; slot++)
+    {
+        m_ItemBoxes[slot] = boxes[m_Items[slot]];
+        m_ItemSlots[m_Items[slot]] = slot;
+    }
+
+    m_ItemLeaves.resize(itemCount);
+    for (u32 node = 0; node < m_Nodes.size(); node++)
+    {
+        if (m_Nodes[node].leftChild != 0)
+            continue;
+
+        for (u32 slot = m_Nodes[node].firstItem;
+             slot < m_Nodes[node].firstItem + m_Nodes[node].itemCount; slot++)
+            m_ItemLeaves[m_Items[slot]] = node;
+    }
+
+    m_DirtyNodes.assign(m_Nodes.size(), false);
+}
+
+void BVH::RefitNode(u32 node)
+{
+    auto& n = m_Nodes[node];
+    if (n.leftChild != 0)
+    {
+        n.bounds = m_Nodes[n.leftChild].bounds;
+        Grow(n.bounds, m_Nodes[n.leftChild + 1].bounds);
+        return;
+    }
+
+    n.bounds = GetEmptyBox();
+    for (u32 slot = n.firstItem; slot < n.firstItem + n.itemCount; slot++)
+        Grow(n.bounds, m_ItemBoxes[slot]);
+}
+
+void BVH::Refit(std::span<const BoundingBox> boxes)
+{
+    for (u32 slot = 0; slot < m_Items.size(); slot++)
+        m_ItemBoxes[slot] = boxes[m_Items[slot]];
+
+    for (u32 node = (u32)m_Nodes.size(); node-- > 0;)
+        RefitNode(node);
+}
+
+void BVH::Refit(std::span<const u32> items, std::span<const BoundingBox> boxes)
+{
+    // Every changed leaf and its ancestors, each node once.
+    std::vector<u32> dirtyNodes;
+    for (const auto item : items)
+    {
+        m_ItemBoxes[m_ItemSlots[item]] = boxes[item];
+
+        for (u32 node = m_ItemLeaves[item]; node != u32(-1) && !m_DirtyNodes[node];
+             node = m_Parents[node])
+        {
+            m_DirtyNodes[node] = true;
+            dirtyNodes.push_back(node);
+        }
+    }
+
+    // Children are stored after their parents.
+    std::sort(dirtyNodes.begin(), dirtyNodes.end(), std::greater<u32>());
+    for (const auto node : dirtyNodes)
+    {
+        RefitNode(node);
+        m_DirtyNodes[node] = false;
+    }
+}
+
+void BVH::QueryFrustum(const vec4* frustumPlanes, const vec4* frustumCorners,
+                       std::vector<u32>& visibleItems) const
+{
+    visibleItems.clear();
+    if (m_Nodes.empty())
+        return;
+
+    const FrustumTest test = CreateFrustumTest(frustumPlanes, frustumCorners);
+
+    std::vector<u32> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+
+    while (!stack.empty())
+    {
+        const BVHNode& node = m_Nodes[stack.back()];
+        stack.pop_back();
+
+        const auto result = TestBox(test, node.bounds);
+        if (result == FrustumTestResult::OUTSIDE)
+            continue;
+
+        if (result == FrustumTestResult::INSIDE)
+        {
+            visibleItems.insert(visibleItems.end(), m_Items.begin() + node.firstItem,
+                                m_Items.begin() + node.firstItem + node.itemCount);
+        }
+        else if (node.leftChild != 0)
+        {
+            stack.push_back(node.leftChild + 1);
+            stack.push_back(node.leftChild);
+        }
+        else
+        {
+            for (u32 slot = node.firstItem; slot < node.firstItem + node.itemCount; slot++)
+            {
+                if (TestBox(test, m_ItemBoxes[slot]) != FrustumTestResult::OUTSIDE)
+                    visibleItems.push_back(m_Items[slot]);
+            }
+        }
+    }
+}
+
+} // namespace Nerine
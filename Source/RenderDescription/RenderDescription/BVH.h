@@ -0,0 +1,83 @@
+#pragma once
+
+#include "BoundingBox.h"
+
+#include <Core/Types.h>
+
+#include <span>
+#include <vector>
+
+namespace Nerine
+{
+
+struct BVHNode
+{
+    BoundingBox bounds;
+
+    // Items of the subtree, the items of every subtree are contiguous.
+    u32 firstItem;
+    u32 itemCount;
+
+    // Index of the left child, the right child follows it. 0 for leaves, the root is never a child.
+    u32 leftChild;
+};
+
+/*
+ * Bounding volume hierarchy over world space boxes, e.g. the draw bounding boxes of a scene. Built
+ * top down with a binned SAH, the nodes are stored depth first in one array, so children always
+ * come after their parent. Items are the indices of the boxes passed to Build().
+ */
+class BVH
+{
+public:
+    void Build(std::span<const BoundingBox> boxes);
+
+    /*
+     * Updates the bounds of every item and node for moved boxes, the tree itself is kept. Query
+     * performance degrades when boxes move far from where they were at build time.
+     */
+    void Refit(std::span<const BoundingBox> boxes);
+
+    /*
+     * Refit of the listed items only, boxes is indexed by item like in Build().
+     */
+    void Refit(std::span<const u32> items, std::span<const BoundingBox> boxes);
+
+    /*
+     * Replaces visibleItems with the items that pass IsBoxInFrustum, in tree order. Subtrees
+     * completely inside the frustum are added without testing their items.
+     */
+    void QueryFrustum(const vec4* frustumPlanes, const vec4* frustumCorners,
+                      std::vector<u32>& visibleItems) const;
+
+    [[nodiscard]] bool IsEmpty() const
+    {
+        return m_Nodes.empty();
+    }
+
+    [[nodiscard]] std::span<const BVHNode> GetNodes() const
+    {
+        return m_Nodes;
+    }
+
+private:
+    void RefitNode(u32 node);
+
+    std::vector<BVHNode> m_Nodes;
+
+    // Parent of every node, u32(-1) for the root.
+    std::vector<u32> m_Parents;
+
+    // Item of every slot in tree order, and the boxes in the same order.
+    std::vector<u32> m_Items;
+    std::vector<BoundingBox> m_ItemBoxes;
+
+    // Slot and leaf node of every item.
+    std::vector<u32> m_ItemSlots;
+    std::vector<u32> m_ItemLeaves;
+
+    // All false outside of Refit().
+    std::vector<bool> m_DirtyNodes;
+};
+
+} // namespace Nerine
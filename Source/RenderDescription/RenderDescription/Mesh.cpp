@@ -2,15 +2,426 @@
 
 #include <Core/Logger.h>
 
+#include <meshoptimizer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <execution>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 
 namespace fs = std::filesystem;
 
 namespace Nerine
 {
 
-static constexpr auto MESH_HEADER_MAGIC_NUMBER = 0x12345678;
+static constexpr u32 MESH_FILE_MAGIC_NUMBER = 0x48534D4E; // "NMSH"
+
+namespace
+{
+
+/*
+ * Legacy (v1) mesh file: header, meshes, bounding boxes, index data and vertex data.
+ */
+constexpr u32 MESH_HEADER_MAGIC_NUMBER_V1 = 0x12345678;
+
+struct MeshFileHeaderV1
+{
+    u32 magicNumber;
+
+    u32 meshCount;
+    // Offset to start of mesh data, i.e vertex and index data
+    u32 dataBlockStartOffset;
+
+    // Raw data sizes, not vertex/index count.
+    u32 indexDataSize;
+    u32 vertexDataSize;
+};
+
+// Size of Mesh in v1 files, fields added since then are appended to the end.
+constexpr u32 MESH_V1_SIZE = sizeof(u32) * (5 + MAX_LODS + MAX_STREAMS * 2);
+
+/*
+ * Older Mesh layouts are a prefix of the current one, copy what is there and leave the remaining
+ * fields at their defaults.
+ */
+void ConvertLegacyMeshes(MeshDataView& meshData, const u8* data, u32 meshCount, u32 meshSize)
+{
+    auto& meshes = meshData.decodedData.meshes;
+    meshes.resize(meshCount);
+
+    for (u32 i = 0; i < meshCount; i++)
+        memcpy(&meshes[i], data + (size_t)meshSize * i, meshSize);
+
+    meshData.meshes = meshes;
+}
+
+struct MeshChunkPayload
+{
+    MeshFileChunk chunk;
+
+    // Unencoded chunk data.
+    const void* data{nullptr};
+    std::vector<u8> encoded;
+
+    // Vertex count of the mesh the chunk belongs to, bounds the index encoding.
+    u32 vertexCount{0};
+};
+
+constexpr u32 AlignChunkSize(u32 size)
+{
+    return (size + 3) & ~3u;
+}
+
+MeshChunkPayload CreateChunk(MeshChunkType type, MeshChunkEncoding encoding, const void* data,
+                             u32 elementCount, u32 elementSize, u32 dataOffset,
+                             u32 vertexCount = 0)
+{
+    return MeshChunkPayload{
+        .chunk = {.type = type,
+                  .encoding = encoding,
+                  .elementCount = elementCount,
+                  .elementSize = elementSize,
+                  .fileOffset = 0,
+                  .fileSize = elementCount * elementSize,
+                  .dataOffset = dataOffset},
+        .data = data,
+        .vertexCount = vertexCount,
+    };
+}
+
+void EncodeChunk(MeshChunkPayload& payload)
+{
+    auto& chunk = payload.chunk;
+    if (chunk.encoding == MeshChunkEncoding::Raw || chunk.elementCount == 0)
+    {
+        chunk.encoding = MeshChunkEncoding::Raw;
+        return;
+    }
+
+    if (chunk.encoding == MeshChunkEncoding::MeshoptIndex)
+    {
+        // The index codec only handles triangle lists.
+        if (chunk.elementCount % 3 != 0)
+        {
+            chunk.encoding = MeshChunkEncoding::Raw;
+            return;
+        }
+
+        payload.encoded.resize(
+            meshopt_encodeIndexBufferBound(chunk.elementCount, payload.vertexCount));
+        if (chunk.elementSize == sizeof(u16))
+            payload.encoded.resize(meshopt_encodeIndexBuffer(
+                payload.encoded.data(), payload.encoded.size(),
+                static_cast<const u16*>(payload.data), chunk.elementCount));
+        else
+            payload.encoded.resize(meshopt_encodeIndexBuffer(
+                payload.encoded.data(), payload.encoded.size(),
+                static_cast<const u32*>(payload.data), chunk.elementCount));
+    }
+    else
+    {
+        // The vertex codec only handles strides that are a multiple of 4, up to 256 bytes.
+        if (chunk.elementSize % 4 != 0 || chunk.elementSize > 256)
+        {
+            chunk.encoding = MeshChunkEncoding::Raw;
+            return;
+        }
+
+        payload.encoded.resize(
+            meshopt_encodeVertexBufferBound(chunk.elementCount, chunk.elementSize));
+        payload.encoded.resize(meshopt_encodeVertexBuffer(
+            payload.encoded.data(), payload.encoded.size(), payload.data, chunk.elementCount,
+            chunk.elementSize));
+    }
+
+    // Keep incompressible chunks raw.
+    if (payload.encoded.empty() || payload.encoded.size() >= chunk.fileSize)
+    {
+        chunk.encoding = MeshChunkEncoding::Raw;
+        payload.encoded.clear();
+        return;
+    }
+
+    chunk.fileSize = (u32)payload.encoded.size();
+}
+
+bool DecodeChunk(const MeshFileChunk& chunk, const u8* src, u8* dst)
+{
+    switch (chunk.encoding)
+    {
+    case MeshChunkEncoding::Raw:
+        if (chunk.fileSize != chunk.elementCount * chunk.elementSize)
+            return false;
+        memcpy(dst, src, chunk.fileSize);
+        return true;
+    case MeshChunkEncoding::MeshoptIndex:
+        return meshopt_decodeIndexBuffer(dst, chunk.elementCount, chunk.elementSize, src,
+                                         chunk.fileSize)
+               == 0;
+    case MeshChunkEncoding::MeshoptVertex:
+        return meshopt_decodeVertexBuffer(dst, chunk.elementCount, chunk.elementSize, src,
+                                          chunk.fileSize)
+               == 0;
+    }
+
+    return false;
+}
+
+template <typename T> std::span<const T> MakeFileSpan(const u8* data, size_t offset, size_t count)
+{
+    return {reinterpret_cast<const T*>(data + offset), count};
+}
+
+/*
+ * The mapping itself is page aligned, so typed in place access only needs an aligned offset.
+ */
+template <typename T> bool IsAlignedFileOffset(size_t offset)
+{
+    return offset % alignof(T) == 0;
+}
+
+template <typename T>
+bool SetRawChunkSpan(std::span<const T>& span, const u8* data, const MeshFileChunk& chunk)
+{
+    if (chunk.encoding != MeshChunkEncoding::Raw || chunk.elementSize != sizeof(T)
+        || (size_t)chunk.elementCount * chunk.elementSize != chunk.fileSize
+        || !IsAlignedFileOffset<T>(chunk.fileOffset))
+        return false;
+
+    span = MakeFileSpan<T>(data, chunk.fileOffset, chunk.elementCount);
+    return true;
+}
+
+bool LoadLegacyMeshData(MeshDataView& meshData, MeshFileHeader& header)
+{
+    const u8* data = meshData.file.GetData();
+    const size_t fileSize = meshData.file.GetSize();
+
+    MeshFileHeaderV1 headerV1;
+    if (fileSize < sizeof(headerV1))
+        return false;
+
+    memcpy(&headerV1, data, sizeof(headerV1));
+
+    const size_t meshesOffset = sizeof(MeshFileHeaderV1);
+    const size_t boundingBoxesOffset = meshesOffset + MESH_V1_SIZE * headerV1.meshCount;
+    const size_t indexDataOffset = boundingBoxesOffset + sizeof(BoundingBox) * headerV1.meshCount;
+    const size_t vertexDataOffset = indexDataOffset + headerV1.indexDataSize;
+
+    if (vertexDataOffset + headerV1.vertexDataSize > fileSize)
+        return false;
+
+    ConvertLegacyMeshes(meshData, data + meshesOffset, headerV1.meshCount, MESH_V1_SIZE);
+    meshData.boundingBoxes
+        = MakeFileSpan<BoundingBox>(data, boundingBoxesOffset, headerV1.meshCount);
+    meshData.indexData
+        = MakeFileSpan<u32>(data, indexDataOffset, headerV1.indexDataSize / sizeof(u32));
+    meshData.vertexData
+        = MakeFileSpan<float>(data, vertexDataOffset, headerV1.vertexDataSize / sizeof(float));
+
+    header = {
+        .magicNumber = headerV1.magicNumber,
+        .version = 1,
+        .meshCount = headerV1.meshCount,
+        .chunkCount = 0,
+        .indexDataSize = headerV1.indexDataSize,
+        .vertexDataSize = headerV1.vertexDataSize,
+        .indexData16Size = 0,
+    };
+
+    return true;
+}
+
+/*
+ * Returns the chunk if the whole stream is stored as a single raw chunk, i.e. it can be used in
+ * place from the file mapping.
+ */
+const MeshFileChunk* FindInPlaceChunk(std::span<const MeshFileChunk> chunks, MeshChunkType type,
+                                      u32 streamSize)
+{
+    const MeshFileChunk* result = nullptr;
+    for (const auto& chunk : chunks)
+    {
+        if (chunk.type != type)
+            continue;
+        if (result != nullptr)
+            return nullptr;
+        result = &chunk;
+    }
+
+    if (result == nullptr || result->encoding != MeshChunkEncoding::Raw || result->dataOffset != 0
+        || result->fileSize != streamSize)
+        return nullptr;
+
+    return result;
+}
+
+bool LoadMeshChunks(MeshDataView& meshData, const MeshFileHeader& header, size_t headerSize)
+{
+    const u8* data = meshData.file.GetData();
+    const size_t fileSize = meshData.file.GetSize();
+
+    const size_t chunkTableOffset = headerSize;
+    if (chunkTableOffset + sizeof(MeshFileChunk) * header.chunkCount > fileSize
+        || !IsAlignedFileOffset<MeshFileChunk>(chunkTableOffset))
+        return false;
+
+    const auto chunks = MakeFileSpan<MeshFileChunk>(data, chunkTableOffset, header.chunkCount);
+
+    for (const auto& chunk : chunks)
+    {
+        if ((size_t)chunk.fileOffset + chunk.fileSize > fileSize)
+            return false;
+    }
+
+    for (const auto& chunk : chunks)
+    {
+        if (chunk.type == MeshChunkType::Meshes && chunk.encoding == MeshChunkEncoding::Raw
+            && chunk.elementCount == header.meshCount)
+        {
+            if (chunk.elementSize == sizeof(Mesh))
+            {
+                if (!IsAlignedFileOffset<Mesh>(chunk.fileOffset))
+                    return false;
+                meshData.meshes = MakeFileSpan<Mesh>(data, chunk.fileOffset, chunk.elementCount);
+            }
+            else if (chunk.elementSize >= MESH_V1_SIZE && chunk.elementSize < sizeof(Mesh)
+                     && chunk.elementSize % sizeof(u32) == 0)
+                ConvertLegacyMeshes(meshData, data + chunk.fileOffset, chunk.elementCount,
+                                    chunk.elementSize);
+        }
+
+        if (chunk.type == MeshChunkType::BoundingBoxes && chunk.encoding == MeshChunkEncoding::Raw
+            && chunk.elementSize == sizeof(BoundingBox) && chunk.elementCount == header.meshCount)
+        {
+            if (!IsAlignedFileOffset<BoundingBox>(chunk.fileOffset))
+                return false;
+            meshData.boundingBoxes
+                = MakeFileSpan<BoundingBox>(data, chunk.fileOffset, chunk.elementCount);
+        }
+
+        bool validMeshletChunk = true;
+        if (chunk.type == MeshChunkType::Meshlets)
+            validMeshletChunk = SetRawChunkSpan(meshData.meshlets, data, chunk);
+        else if (chunk.type == MeshChunkType::MeshletBounds)
+            validMeshletChunk = SetRawChunkSpan(meshData.meshletBounds, data, chunk);
+        else if (chunk.type == MeshChunkType::MeshletVertices)
+            validMeshletChunk = SetRawChunkSpan(meshData.meshletVertices, data, chunk);
+        else if (chunk.type == MeshChunkType::MeshletTriangles)
+            validMeshletChunk = SetRawChunkSpan(meshData.meshletTriangles, data, chunk);
+
+        if (!validMeshletChunk)
+            return false;
+    }
+
+    if (meshData.meshlets.size() != meshData.meshletBounds.size())
+        return false;
+
+    if (meshData.meshes.size() != header.meshCount
+        || meshData.boundingBoxes.size() != header.meshCount)
+        return false;
+
+    const auto* indexChunk = FindInPlaceChunk(chunks, MeshChunkType::Indices, header.indexDataSize);
+    const auto* index16Chunk
+        = FindInPlaceChunk(chunks, MeshChunkType::Indices16, header.indexData16Size);
+    const auto* vertexChunk
+        = FindInPlaceChunk(chunks, MeshChunkType::Vertices, header.vertexDataSize);
+
+    if ((indexChunk != nullptr && !IsAlignedFileOffset<u32>(indexChunk->fileOffset))
+        || (index16Chunk != nullptr && !IsAlignedFileOffset<u16>(index16Chunk->fileOffset))
+        || (vertexChunk != nullptr && !IsAlignedFileOffset<float>(vertexChunk->fileOffset)))
+        return false;
+
+    if (indexChunk != nullptr)
+        meshData.indexData = MakeFileSpan<u32>(data, indexChunk->fileOffset,
+                                               header.indexDataSize / sizeof(u32));
+    else
+        meshData.decodedData.indexData.resize(header.indexDataSize / sizeof(u32));
+
+    if (index16Chunk != nullptr)
+        meshData.indexData16 = MakeFileSpan<u16>(data, index16Chunk->fileOffset,
+                                                 header.indexData16Size / sizeof(u16));
+    else
+        meshData.decodedData.indexData16.resize(header.indexData16Size / sizeof(u16));
+
+    if (vertexChunk != nullptr)
+        meshData.vertexData = MakeFileSpan<float>(data, vertexChunk->fileOffset,
+                                                  header.vertexDataSize / sizeof(float));
+    else
+        meshData.decodedData.vertexData.resize(header.vertexDataSize / sizeof(float));
+
+    // Collect the chunks that can not be used in place, the streams are decoded in parallel.
+    std::vector<std::pair<const MeshFileChunk*, u8*>> decodeChunks;
+    for (const auto& chunk : chunks)
+    {
+        u8* stream = nullptr;
+        u32 streamSize = 0;
+
+        if (chunk.type == MeshChunkType::Indices && indexChunk == nullptr)
+        {
+            stream = reinterpret_cast<u8*>(meshData.decodedData.indexData.data());
+            streamSize = header.indexDataSize;
+        }
+        else if (chunk.type == MeshChunkType::Indices16 && index16Chunk == nullptr)
+        {
+            stream = reinterpret_cast<u8*>(meshData.decodedData.indexData16.data());
+            streamSize = header.indexData16Size;
+        }
+        else if (chunk.type == MeshChunkType::Vertices && vertexChunk == nullptr)
+        {
+            stream = reinterpret_cast<u8*>(meshData.decodedData.vertexData.data());
+            streamSize = header.vertexDataSize;
+        }
+        else
+        {
+            continue;
+        }
+
+        if ((size_t)chunk.dataOffset + (size_t)chunk.elementCount * chunk.elementSize > streamSize)
+            return false;
+
+        decodeChunks.emplace_back(&chunk, stream + chunk.dataOffset);
+    }
+
+    // Chunks are decoded concurrently, so no two of them may write the same bytes. The streams are
+    // separate allocations, sorting by destination address puts overlapping chunks next to each
+    // other.
+    std::sort(decodeChunks.begin(), decodeChunks.end(), [](const auto& a, const auto& b) {
+        return std::less<const u8*>()(a.second, b.second);
+    });
+    for (size_t i = 1; i < decodeChunks.size(); i++)
+    {
+        const auto& [previous, previousDst] = decodeChunks[i - 1];
+        const size_t previousSize = (size_t)previous->elementCount * previous->elementSize;
+        if (std::less<const u8*>()(decodeChunks[i].second, previousDst + previousSize))
+            return false;
+    }
+
+    std::atomic<bool> decodeFailed{false};
+    std::for_each(std::execution::par, decodeChunks.begin(), decodeChunks.end(),
+                  [&](const std::pair<const MeshFileChunk*, u8*>& c) {
+                      if (!DecodeChunk(*c.first, data + c.first->fileOffset, c.second))
+                          decodeFailed = true;
+                  });
+
+    if (decodeFailed)
+        return false;
+
+    if (indexChunk == nullptr)
+        meshData.indexData = meshData.decodedData.indexData;
+    if (index16Chunk == nullptr)
+        meshData.indexData16 = meshData.decodedData.indexData16;
+    if (vertexChunk == nullptr)
+        meshData.vertexData = meshData.decodedData.vertexData;
+
+    return true;
+}
+
+} // namespace
 
 std::vector<DrawData> CreateMeshDrawData(const MeshData& meshData)
 {
@@ -28,6 +439,8 @@ std::vector<DrawData> CreateMeshDrawData(const MeshData& meshData)
             .indexOffset = meshData.meshes[i].indexOffset,
             .vertexOffset = vertexOffset,
             .transformIndex = 0,
+            .flags = u32((meshData.meshes[i].indexFormat == IndexFormat::U16) ? DrawFlags::INDEX16
+                                                                               : DrawFlags::NONE),
         });
 
         vertexOffset += meshData.meshes[i].vertexCount;
@@ -47,19 +460,91 @@ void RecalculateBoundingBoxes(MeshData& meshData)
         vec3 vmin(std::numeric_limits<float>::max());
         vec3 vmax(std::numeric_limits<float>::lowest());
 
+        const auto* vertices
+            = reinterpret_cast<const u8*>(meshData.vertexData.data()) + mesh.streamOffset[0];
+        const auto dequantize = GetVertexDequantizationTransform(mesh);
+
         for (auto i = 0; i != numIndices; i++)
         {
-            auto vtxOffset = meshData.indexData[mesh.indexOffset + i] + mesh.vertexOffset;
-            const float* vf = &meshData.vertexData[vtxOffset * MAX_STREAMS];
-            vmin = glm::min(vmin, vec3(vf[0], vf[1], vf[2]));
-            vmax = glm::max(vmax, vec3(vf[0], vf[1], vf[2]));
+            const u32 index = (mesh.indexFormat == IndexFormat::U16)
+                                  ? meshData.indexData16[mesh.indexOffset + i]
+                                  : meshData.indexData[mesh.indexOffset + i];
+            const auto* vertex = vertices + index * mesh.streamElementSize[0];
+
+            vec3 position;
+            if (mesh.vertexFormat == VertexFormat::Quantized)
+            {
+                QuantizedVertex v;
+                memcpy(&v, vertex, sizeof(v));
+                position = vec3(dequantize
+                                * vec4(vec3(v.position[0], v.position[1], v.position[2]) / 65535.0f,
+                                       1.0f));
+            }
+            else
+            {
+                memcpy(&position, vertex, sizeof(position));
+            }
+
+            vmin = glm::min(vmin, position);
+            vmax = glm::max(vmax, position);
         }
 
         meshData.boundingBoxes.emplace_back(vmin, vmax);
     }
 }
 
-bool SaveMeshData(const std::string& fileName, const MeshData& meshData)
+mat4 GetVertexDequantizationTransform(const Mesh& mesh)
+{
+    if (mesh.vertexFormat != VertexFormat::Quantized)
+        return mat4(1.0f);
+
+    mat4 transform(mesh.positionScale);
+    transform[3]
+        = vec4(mesh.positionOffset[0], mesh.positionOffset[1], mesh.positionOffset[2], 1.0f);
+    return transform;
+}
+
+void CullMeshlets(const Mesh& mesh, std::span<const MeshletBounds> meshletBounds,
+                  const mat4& model, const vec4* frustumPlanes, const vec3& cameraPos,
+                  std::vector<u32>& visibleMeshlets)
+{
+    // Sphere tests need actual distances, planes extracted from a matrix are not normalized.
+    vec4 planes[6];
+    for (int i = 0; i < 6; i++)
+        planes[i] = frustumPlanes[i] / glm::length(vec3(frustumPlanes[i]));
+
+    const mat3 normalMatrix = glm::transpose(glm::inverse(mat3(model)));
+    const float radiusScale = std::max(
+        {glm::length(vec3(model[0])), glm::length(vec3(model[1])), glm::length(vec3(model[2]))});
+
+    for (u32 i = 0; i < mesh.meshletCount; i++)
+    {
+        const auto& bounds = meshletBounds[mesh.meshletOffset + i];
+
+        const vec3 center = vec3(model * vec4(bounds.center, 1.0f));
+        const float radius = bounds.radius * radiusScale;
+
+        bool inFrustum = true;
+        for (int p = 0; p < 6 && inFrustum; p++)
+            inFrustum = glm::dot(planes[p], vec4(center, 1.0f)) >= -radius;
+
+        if (!inFrustum)
+            continue;
+
+        // A cutoff of 1 marks a degenerate cone that never culls.
+        if (bounds.coneCutoff < 1.0f)
+        {
+            const vec3 apex = vec3(model * vec4(bounds.coneApex, 1.0f));
+            const vec3 axis = glm::normalize(normalMatrix * bounds.coneAxis);
+            if (glm::dot(glm::normalize(apex - cameraPos), axis) >= bounds.coneCutoff)
+                continue;
+        }
+
+        visibleMeshlets.push_back(mesh.meshletOffset + i);
+    }
+}
+
+bool SaveMeshData(const std::string& fileName, const MeshData& meshData, bool compress)
 {
     std::ofstream outFile(fileName, std::ios::out | std::ios::binary);
     if (!outFile)
@@ -68,23 +553,102 @@ bool SaveMeshData(const std::string& fileName, const MeshData& meshData)
         return false;
     }
 
-    const MeshFileHeader header = {
-        .magicNumber = MESH_HEADER_MAGIC_NUMBER,
+    MeshFileHeader header = {
+        .magicNumber = MESH_FILE_MAGIC_NUMBER,
+        .version = MESH_FILE_VERSION,
         .meshCount = (u32)meshData.meshes.size(),
-        .dataBlockStartOffset
-        = (u32)(sizeof(MeshFileHeader) + meshData.meshes.size() * sizeof(Mesh)),
+        .chunkCount = 0,
         .indexDataSize = (u32)(meshData.indexData.size() * sizeof(u32)),
         .vertexDataSize = (u32)(meshData.vertexData.size() * sizeof(float)),
+        .indexData16Size = (u32)(meshData.indexData16.size() * sizeof(u16)),
     };
 
     LOG_INFO("save MeshData indexDataSize: ", header.indexDataSize);
+    LOG_INFO("save MeshData indexData16Size: ", header.indexData16Size);
     LOG_INFO("save MeshData vertexDataSize: ", header.vertexDataSize);
 
+    std::vector<MeshChunkPayload> chunks;
+    chunks.push_back(CreateChunk(MeshChunkType::Meshes, MeshChunkEncoding::Raw,
+                                 meshData.meshes.data(), header.meshCount, sizeof(Mesh), 0));
+    chunks.push_back(CreateChunk(MeshChunkType::BoundingBoxes, MeshChunkEncoding::Raw,
+                                 meshData.boundingBoxes.data(), header.meshCount,
+                                 sizeof(BoundingBox), 0));
+
+    if (!meshData.meshlets.empty())
+    {
+        chunks.push_back(CreateChunk(MeshChunkType::Meshlets, MeshChunkEncoding::Raw,
+                                     meshData.meshlets.data(), (u32)meshData.meshlets.size(),
+                                     sizeof(Meshlet), 0));
+        chunks.push_back(CreateChunk(MeshChunkType::MeshletBounds, MeshChunkEncoding::Raw,
+                                     meshData.meshletBounds.data(),
+                                     (u32)meshData.meshletBounds.size(), sizeof(MeshletBounds), 0));
+        chunks.push_back(CreateChunk(MeshChunkType::MeshletVertices, MeshChunkEncoding::Raw,
+                                     meshData.meshletVertices.data(),
+                                     (u32)meshData.meshletVertices.size(), sizeof(u32), 0));
+        chunks.push_back(CreateChunk(MeshChunkType::MeshletTriangles, MeshChunkEncoding::Raw,
+                                     meshData.meshletTriangles.data(),
+                                     (u32)meshData.meshletTriangles.size(), sizeof(u8), 0));
+    }
+
+    if (compress)
+    {
+        // One index and one vertex chunk per mesh, the codecs work best on mesh local data.
+        for (const auto& mesh : meshData.meshes)
+        {
+            if (mesh.indexFormat == IndexFormat::U16)
+                chunks.push_back(CreateChunk(
+                    MeshChunkType::Indices16, MeshChunkEncoding::MeshoptIndex,
+                    meshData.indexData16.data() + mesh.indexOffset, mesh.lodOffset[mesh.lodCount],
+                    sizeof(u16), mesh.indexOffset * sizeof(u16), mesh.vertexCount));
+            else
+                chunks.push_back(CreateChunk(
+                    MeshChunkType::Indices, MeshChunkEncoding::MeshoptIndex,
+                    meshData.indexData.data() + mesh.indexOffset, mesh.lodOffset[mesh.lodCount],
+                    sizeof(u32), mesh.indexOffset * sizeof(u32), mesh.vertexCount));
+            chunks.push_back(CreateChunk(
+                MeshChunkType::Vertices, MeshChunkEncoding::MeshoptVertex,
+                reinterpret_cast<const u8*>(meshData.vertexData.data()) + mesh.streamOffset[0],
+                mesh.vertexCount, mesh.streamElementSize[0], mesh.streamOffset[0]));
+        }
+
+        std::for_each(std::execution::par, chunks.begin(), chunks.end(), EncodeChunk);
+    }
+    else
+    {
+        chunks.push_back(CreateChunk(MeshChunkType::Indices, MeshChunkEncoding::Raw,
+                                     meshData.indexData.data(), (u32)meshData.indexData.size(),
+                                     sizeof(u32), 0));
+        chunks.push_back(CreateChunk(MeshChunkType::Indices16, MeshChunkEncoding::Raw,
+                                     meshData.indexData16.data(),
+                                     (u32)meshData.indexData16.size(), sizeof(u16), 0));
+        chunks.push_back(CreateChunk(MeshChunkType::Vertices, MeshChunkEncoding::Raw,
+                                     meshData.vertexData.data(), (u32)meshData.vertexData.size(),
+                                     sizeof(float), 0));
+    }
+
+    header.chunkCount = (u32)chunks.size();
+
+    u32 fileOffset = (u32)(sizeof(MeshFileHeader) + sizeof(MeshFileChunk) * chunks.size());
+    for (auto& payload : chunks)
+    {
+        payload.chunk.fileOffset = fileOffset;
+        fileOffset += AlignChunkSize(payload.chunk.fileSize);
+    }
+
+    LOG_INFO("save MeshData file size: ", fileOffset);
+
     outFile.write((char*)&header, sizeof(header));
-    outFile.write((char*)meshData.meshes.data(), sizeof(Mesh) * header.meshCount);
-    outFile.write((char*)meshData.boundingBoxes.data(), sizeof(BoundingBox) * header.meshCount);
-    outFile.write((char*)meshData.indexData.data(), header.indexDataSize);
-    outFile.write((char*)meshData.vertexData.data(), header.vertexDataSize);
+    for (const auto& payload : chunks)
+        outFile.write((char*)&payload.chunk, sizeof(MeshFileChunk));
+
+    const u32 padding = 0;
+    for (const auto& payload : chunks)
+    {
+        const void* data = payload.encoded.empty() ? payload.data : payload.encoded.data();
+        outFile.write((const char*)data, payload.chunk.fileSize);
+        outFile.write((const char*)&padding,
+                      AlignChunkSize(payload.chunk.fileSize) - payload.chunk.fileSize);
+    }
 
     outFile.close();
 
@@ -107,59 +671,104 @@ bool SaveDrawData(const std::string& fileName, const std::vector<DrawData>& draw
 }
 
 MeshFileHeader LoadMeshData(const std::string& fileName, MeshData& meshData)
+{
+    MeshDataView view;
+    const auto header = LoadMeshData(fileName, view);
+    if (header.meshCount == 0)
+        return header;
+
+    meshData.meshes.assign(view.meshes.begin(), view.meshes.end());
+    meshData.boundingBoxes.assign(view.boundingBoxes.begin(), view.boundingBoxes.end());
+    meshData.meshlets.assign(view.meshlets.begin(), view.meshlets.end());
+    meshData.meshletBounds.assign(view.meshletBounds.begin(), view.meshletBounds.end());
+    meshData.meshletVertices.assign(view.meshletVertices.begin(), view.meshletVertices.end());
+    meshData.meshletTriangles.assign(view.meshletTriangles.begin(), view.meshletTriangles.end());
+
+    // Take over decoded streams instead of copying them.
+    if (!view.decodedData.indexData.empty())
+        meshData.indexData = std::move(view.decodedData.indexData);
+    else
+        meshData.indexData.assign(view.indexData.begin(), view.indexData.end());
+
+    if (!view.decodedData.indexData16.empty())
+        meshData.indexData16 = std::move(view.decodedData.indexData16);
+    else
+        meshData.indexData16.assign(view.indexData16.begin(), view.indexData16.end());
+
+    if (!view.decodedData.vertexData.empty())
+        meshData.vertexData = std::move(view.decodedData.vertexData);
+    else
+        meshData.vertexData.assign(view.vertexData.begin(), view.vertexData.end());
+
+    return header;
+}
+
+MeshFileHeader LoadMeshData(const std::string& fileName, MeshDataView& meshData)
 {
     MeshFileHeader header;
     header.meshCount = 0;
 
-    std::ifstream inFile(fileName, std::ios::out | std::ios::binary);
-    if (!inFile)
+    meshData = MeshDataView();
+
+    if (!meshData.file.Open(fileName))
     {
         LOG_ERROR("loadMeshData: failed to open ", fs::absolute(fileName));
         return header;
     }
 
-    inFile.read((char*)&header, sizeof(header));
-    if (!inFile.good())
-    {
-        LOG_ERROR("loadMeshData: failed to read file header ", fileName);
-        inFile.close();
-        header.meshCount = 0;
+    const u8* data = meshData.file.GetData();
+    const size_t fileSize = meshData.file.GetSize();
 
-        return header;
+    u32 magicNumber = 0;
+    if (fileSize >= sizeof(magicNumber))
+        memcpy(&magicNumber, data, sizeof(magicNumber));
+
+    bool loaded = false;
+    if (magicNumber == MESH_HEADER_MAGIC_NUMBER_V1)
+    {
+        loaded = LoadLegacyMeshData(meshData, header);
     }
+    else if (magicNumber == MESH_FILE_MAGIC_NUMBER && fileSize >= sizeof(header))
+    {
+        memcpy(&header, data, sizeof(header));
+
+        // v2 headers end before indexData16Size, the chunk table follows right after.
+        size_t headerSize = sizeof(header);
+        if (header.version == 2)
+        {
+            headerSize = offsetof(MeshFileHeader, indexData16Size);
+            header.indexData16Size = 0;
+        }
+
+        if (header.version < 2 || header.version > MESH_FILE_VERSION)
+        {
+            LOG_ERROR("loadMeshData: ", fileName, " has unsupported version ", header.version);
+            meshData = MeshDataView();
+            header.meshCount = 0;
 
-    if (header.magicNumber != MESH_HEADER_MAGIC_NUMBER)
+            return header;
+        }
+
+        loaded = LoadMeshChunks(meshData, header, headerSize);
+    }
+    else
     {
         LOG_ERROR("loadMeshData: ", fileName, " is not a mesh type file");
-        inFile.close();
+        meshData = MeshDataView();
         header.meshCount = 0;
 
         return header;
     }
 
-    meshData.meshes.resize(header.meshCount);
-    inFile.read((char*)meshData.meshes.data(), sizeof(Mesh) * header.meshCount);
-
-    meshData.boundingBoxes.resize(header.meshCount);
-    inFile.read((char*)meshData.boundingBoxes.data(), sizeof(BoundingBox) * header.meshCount);
-
-    meshData.indexData.resize(header.indexDataSize / sizeof(u32));
-    inFile.read((char*)meshData.indexData.data(), header.indexDataSize);
-
-    meshData.vertexData.resize(header.vertexDataSize / sizeof(float));
-    inFile.read((char*)meshData.vertexData.data(), header.vertexDataSize);
-
-    if (!inFile.good())
+    if (!loaded)
     {
         LOG_ERROR("loadMeshData: failed to read mesh data ", fileName);
-        inFile.close();
+        meshData = MeshDataView();
         header.meshCount = 0;
 
         return header;
     }
 
-    inFile.close();
-
     return header;
 }
 
@@ -2,6 +2,9 @@
 
 #include "BoundingBox.h"
 
+#include <Core/MappedFile.h>
+
+#include <span>
 #include <string>
 
 namespace Nerine
@@ -10,6 +13,70 @@ namespace Nerine
 constexpr auto MAX_LODS = 8;
 constexpr auto MAX_STREAMS = 8;
 
+enum class VertexFormat : u32
+{
+    // Position vec3, UV vec2, normal vec3, all 32-bit floats.
+    Float = 0,
+    // QuantizedVertex.
+    Quantized = 1,
+};
+
+/*
+ * Quantized vertex, 16 bytes instead of 32.
+ */
+struct QuantizedVertex
+{
+    // 16-bit unorm position relative to the mesh bounding box, w is padding.
+    u16 position[4];
+    // Half float UV.
+    u16 uv[2];
+    // 16-bit snorm octahedral encoded normal.
+    i16 normal[2];
+};
+
+static_assert(sizeof(QuantizedVertex) == 16, "Size of QuantizedVertex must be 16 bytes!");
+
+enum class IndexFormat : u32
+{
+    // Indices live in MeshData::indexData.
+    U32 = 0,
+    // Indices live in MeshData::indexData16.
+    U16 = 1,
+};
+
+// Meshlet limits, the triangle count has to be divisible by 4 for meshopt_buildMeshlets.
+constexpr u32 MESHLET_MAX_VERTICES = 64;
+constexpr u32 MESHLET_MAX_TRIANGLES = 124;
+
+/*
+ * Cluster of triangles of a mesh's LOD 0.
+ */
+struct Meshlet
+{
+    // Offset into MeshData::meshletVertices, which hold mesh relative vertex indices.
+    u32 vertexOffset;
+    // Offset into MeshData::meshletTriangles, which hold 3 meshlet relative u8 indices each.
+    u32 triangleOffset;
+
+    u32 vertexCount;
+    u32 triangleCount;
+};
+
+/*
+ * Meshlet bounds in mesh space, see meshopt_Bounds.
+ */
+struct MeshletBounds
+{
+    vec3 center;
+    float radius;
+
+    // The meshlet is back facing when
+    // dot(normalize(coneApex - cameraPos), coneAxis) >= coneCutoff.
+    vec3 coneApex;
+    vec3 coneAxis;
+    float coneCutoff;
+};
+
 struct Mesh
 {
     u32 lodCount{0};
@@ -27,6 +94,24 @@ struct Mesh
     u32 streamOffset[MAX_STREAMS]{0};
     u32 streamElementSize[MAX_STREAMS]{0};
 
+    VertexFormat vertexFormat{VertexFormat::Float};
+
+    // Quantized positions decode to positionOffset + position * positionScale. The scale is
+    // uniform so that it can be folded into the model matrix without affecting normals.
+    float positionOffset[3]{0.0f};
+    float positionScale{1.0f};
+
+    // Selects the index pool indexOffset refers to. New fields are only ever appended to Mesh,
+    // older file layouts are a prefix of the current one.
+    IndexFormat indexFormat{IndexFormat::U32};
+
+    // Range in MeshData::meshlets/meshletBounds, empty when meshlets were not built.
+    u32 meshletOffset{0};
+    u32 meshletCount{0};
+
+    // Simplification error of each LOD as a mesh space distance, 0 for LOD 0.
+    float lodError[MAX_LODS]{0.0f};
+
     inline u32 GetLODIndicesCount(u32 lod) const
     {
         return lodOffset[lod + 1] - lodOffset[lod];
@@ -36,11 +121,51 @@ struct Mesh
 struct MeshData
 {
     std::vector<u32> indexData;
+    std::vector<u16> indexData16;
     std::vector<float> vertexData;
     std::vector<Mesh> meshes;
     std::vector<BoundingBox> boundingBoxes;
+
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshletBounds> meshletBounds;
+    std::vector<u32> meshletVertices;
+    std::vector<u8> meshletTriangles;
+};
+
+/*
+ * Read-only view of a mesh file. Spans point straight into the memory mapped file, so no
+ * intermediate copies are made when e.g. uploading the index/vertex data to the GPU. Streams that
+ * are stored encoded in the file are decoded into decodedData and the spans point there instead.
+ */
+struct MeshDataView
+{
+    std::span<const u32> indexData;
+    std::span<const u16> indexData16;
+    std::span<const float> vertexData;
+    std::span<const Mesh> meshes;
+    std::span<const BoundingBox> boundingBoxes;
+
+    std::span<const Meshlet> meshlets;
+    std::span<const MeshletBounds> meshletBounds;
+    std::span<const u32> meshletVertices;
+    std::span<const u8> meshletTriangles;
+
+    // Backing storage of the spans above.
+    MappedFile file;
+    MeshData decodedData;
+};
+
+enum class DrawFlags : u32
+{
+    NONE = 0,
+    // The material is alpha blended, drawn in the transparency pass.
+    TRANSPARENT = 1 << 0,
+    // The mesh indices live in the 16-bit index pool.
+    INDEX16 = 1 << 1,
 };
 
+ENUM_CLASS_FLAG_OPERATORS(DrawFlags);
+
 struct DrawData
 {
     u32 meshIndex;
@@ -51,34 +176,103 @@ struct DrawData
 
     // Transform index in scene.
     u32 transformIndex;
+
+    // DrawFlags.
+    u32 flags;
 };
 
+constexpr u32 MESH_FILE_VERSION = 3;
+
+/*
+ * Mesh file (v2 and later) layout: header, chunk table, then the chunk payloads, each aligned to 4
+ * bytes.
+ */
 struct MeshFileHeader
 {
     u32 magicNumber;
+    u32 version;
 
     u32 meshCount;
-    // Offset to start of mesh data, i.e vertex and index data
-    u32 dataBlockStartOffset;
+    u32 chunkCount;
 
-    // Raw data sizes, not vertex/index count.
+    // Decoded data sizes, not vertex/index count.
     u32 indexDataSize;
     u32 vertexDataSize;
+
+    // Added in v3.
+    u32 indexData16Size;
+};
+
+enum class MeshChunkType : u32
+{
+    Meshes = 0,
+    BoundingBoxes = 1,
+    Indices = 2,
+    Vertices = 3,
+    Indices16 = 4,
+    // Meshlet data is always stored raw.
+    Meshlets = 5,
+    MeshletBounds = 6,
+    MeshletVertices = 7,
+    MeshletTriangles = 8,
+};
+
+enum class MeshChunkEncoding : u32
+{
+    Raw = 0,
+    // meshopt_encodeIndexBuffer, triangle list of a single mesh.
+    MeshoptIndex = 1,
+    // meshopt_encodeVertexBuffer, vertices of a single mesh.
+    MeshoptVertex = 2,
+};
+
+struct MeshFileChunk
+{
+    MeshChunkType type;
+    MeshChunkEncoding encoding;
+
+    u32 elementCount;
+    u32 elementSize;
+
+    // Location of the (encoded) payload in the file.
+    u32 fileOffset;
+    u32 fileSize;
+
+    // Byte offset of the decoded payload in its data stream.
+    u32 dataOffset;
 };
 
 static_assert(sizeof(BoundingBox) == (sizeof(float) * 6),
               "Size of Bounding Box must be 6 * sizeof floats!");
-static_assert(sizeof(DrawData) == (sizeof(u32) * 6), "Size of DrawData must be 6 * 32 bits!");
+static_assert(sizeof(DrawData) == (sizeof(u32) * 7), "Size of DrawData must be 7 * 32 bits!");
+static_assert(sizeof(MeshletBounds) == (sizeof(float) * 11),
+              "Size of MeshletBounds must be 11 * sizeof floats!");
 
 // Create 1 DrawData per mesh in MeshData.
 std::vector<DrawData> CreateMeshDrawData(const MeshData& meshData);
 
 void RecalculateBoundingBoxes(MeshData& meshData);
 
-bool SaveMeshData(const std::string& fileName, const MeshData& meshData);
+// Maps vertex positions of the mesh to its object space, identity for unquantized meshes.
+mat4 GetVertexDequantizationTransform(const Mesh& mesh);
+
+/*
+ * CPU cluster culling. Appends the indices of the meshlets of the mesh that intersect the frustum
+ * and are not entirely back facing to visibleMeshlets. model is the global transform of the
+ * mesh, frustum planes (see GetFrustumPlanes) and camera position are in world space.
+ */
+void CullMeshlets(const Mesh& mesh, std::span<const MeshletBounds> meshletBounds,
+                  const mat4& model, const vec4* frustumPlanes, const vec3& cameraPos,
+                  std::vector<u32>& visibleMeshlets);
+
+// Compressed files store index/vertex data as per mesh meshoptimizer encoded chunks, otherwise the
+// streams are stored raw and can be used in place from a MeshDataView.
+bool SaveMeshData(const std::string& fileName, const MeshData& meshData, bool compress = false);
 bool SaveDrawData(const std::string& fileName, const std::vector<DrawData>& drawData);
 
+// Reads current, v2 and legacy (v1) mesh files.
 MeshFileHeader LoadMeshData(const std::string& fileName, MeshData& meshData);
+MeshFileHeader LoadMeshData(const std::string& fileName, MeshDataView& meshData);
 std::vector<DrawData> LoadDrawData(const std::string& fileName);
 
 } // namespace Nerine
@@ -1,24 +1,171 @@
 #include "Scene.h"
+#include "SceneEditor.h"
 #include "Utils.h"
 
+#include <Core/Hash.h>
 #include <Core/Logger.h>
+#include <Core/MathSIMD.h>
 #include <Core/Utils.h>
 
 #include <algorithm>
+#include <cstring>
+#include <execution>
 #include <filesystem>
 #include <fstream>
 #include <numeric>
+#include <type_traits>
 
 namespace fs = std::filesystem;
 
 namespace Nerine
 {
 
+namespace
+{
+
+// Levels with fewer changed nodes are updated on the calling thread.
+constexpr size_t PARALLEL_TRANSFORM_MIN_NODES = 8192;
+constexpr size_t TRANSFORM_CHUNK_SIZE = 2048;
+
+void UpdateGlobalTransform(Scene& scene, u32 node)
+{
+    const u32 parent = scene.hierarchy[node].parent;
+
+    if (scene.useTRS)
+    {
+        mat4 local;
+        ComposeAffine(scene.localTranslations[node], scene.localRotations[node],
+                      scene.localScales[node], local);
+
+        if (parent == u32(-1))
+            scene.globalTransforms[node] = local;
+        else
+            MultiplyAffine(scene.globalTransforms[parent], local, scene.globalTransforms[node]);
+    }
+    else if (parent == u32(-1))
+    {
+        scene.globalTransforms[node] = scene.localTransforms[node];
+    }
+    else
+    {
+        MultiplyMat4(scene.globalTransforms[parent], scene.localTransforms[node],
+                     scene.globalTransforms[node]);
+    }
+}
+
+/*
+ * Calls fn(first, count) over [0, count), split into chunks that run in parallel when there is
+ * enough work.
+ */
+template <typename Fn> void ForEachTransformChunk(size_t count, const Fn& fn)
+{
+    if (count < PARALLEL_TRANSFORM_MIN_NODES)
+    {
+        fn(size_t(0), count);
+        return;
+    }
+
+    std::vector<size_t> chunks((count + TRANSFORM_CHUNK_SIZE - 1) / TRANSFORM_CHUNK_SIZE);
+    std::iota(chunks.begin(), chunks.end(), 0);
+
+    std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        const size_t first = chunk * TRANSFORM_CHUNK_SIZE;
+        fn(first, std::min(TRANSFORM_CHUNK_SIZE, count - first));
+    });
+}
+
+bool IsDepthSorted(const Scene& scene)
+{
+    return !scene.levelOffsets.empty() && scene.levelOffsets.back() == scene.hierarchy.size();
+}
+
+/*
+ * Clears the dirty bits of the nodes and empties the list. Done serially after a level is
+ * updated, neighbouring bits share a word.
+ */
+void ClearDirtyNodes(Scene& scene, std::vector<int>& nodes)
+{
+    for (const auto node : nodes)
+        scene.dirtyNodes[node] = false;
+    nodes.clear();
+}
+
+/*
+ * Splits an affine matrix into translation, rotation and scale. A mirroring is folded into the x
+ * scale, degenerate axes get the identity rotation. Shear is lost.
+ */
+void DecomposeAffine(const mat4& transform, vec3& translation, quat& rotation, vec3& scale)
+{
+    translation = vec3(transform[3]);
+
+    mat3 basis(transform);
+    scale = vec3(glm::length(basis[0]), glm::length(basis[1]), glm::length(basis[2]));
+    if (glm::determinant(basis) < 0.0f)
+        scale.x = -scale.x;
+
+    if (scale.x == 0.0f || scale.y == 0.0f || scale.z == 0.0f)
+    {
+        rotation = quat(1.0f, 0.0f, 0.0f, 0.0f);
+        return;
+    }
+
+    basis[0] /= scale.x;
+    basis[1] /= scale.y;
+    basis[2] /= scale.z;
+    rotation = glm::normalize(glm::quat_cast(basis));
+}
+
+/*
+ * True if composing the decomposed transform gives back the matrix, within float precision. Every
+ * basis column is compared relative to its own length, so neither a large translation nor a large
+ * scale on another axis hides shear.
+ */
+bool IsTRS(const mat4& transform)
+{
+    if (transform[0].w != 0.0f || transform[1].w != 0.0f || transform[2].w != 0.0f
+        || transform[3].w != 1.0f)
+        return false;
+
+    vec3 translation;
+    quat rotation;
+    vec3 scale;
+    DecomposeAffine(transform, translation, rotation, scale);
+
+    mat4 composed;
+    ComposeAffine(translation, rotation, scale, composed);
+
+    constexpr float tolerance = 1e-4f;
+    for (u32 c = 0; c < 3; c++)
+    {
+        const vec3 column(transform[c]);
+        if (glm::length(column - vec3(composed[c])) > tolerance * glm::length(column))
+            return false;
+    }
+
+    const vec3 t(transform[3]);
+    return glm::length(t - vec3(composed[3])) <= tolerance * std::max(glm::length(t), 1.0f);
+}
+
+} // namespace
+
 u32 AddNode(Scene& scene, u32 parent, u32 level)
 {
     u32 node = (u32)scene.hierarchy.size();
-    scene.localTransforms.push_back(glm::mat4(1.0f));
+    if (scene.useTRS)
+    {
+        scene.localTranslations.push_back(vec3(0.0f));
+        scene.localRotations.push_back(quat(1.0f, 0.0f, 0.0f, 0.0f));
+        scene.localScales.push_back(vec3(1.0f));
+    }
+    else
+    {
+        scene.localTransforms.push_back(glm::mat4(1.0f));
+    }
     scene.globalTransforms.push_back(glm::mat4(1.0f));
+    scene.nodeMeshes.push_back(u32(-1));
+    scene.nodeMaterials.push_back(u32(-1));
+    scene.nodeNames.push_back(u32(-1));
+    scene.nameNextNode.push_back(u32(-1));
 
     scene.hierarchy.push_back({
         .parent = parent,
@@ -54,57 +201,216 @@ u32 AddNode(Scene& scene, u32 parent, u32 level)
     scene.hierarchy[node].nextSibling = u32(-1);
     scene.hierarchy[node].firstChild = u32(-1);
 
+    // Appending keeps the breadth first order only on the deepest level or the one below it.
+    if (node == 0)
+        scene.levelOffsets = {0};
+
+    if (!scene.levelOffsets.empty())
+    {
+        const u32 levelCount = (u32)scene.levelOffsets.size() - 1;
+        if (level + 1 == levelCount)
+            scene.levelOffsets.back() = node + 1;
+        else if (level == levelCount)
+            scene.levelOffsets.push_back(node + 1);
+        else
+            scene.levelOffsets.clear();
+    }
+
     return node;
 }
 
-void RecalculateGlobalTransforms(Scene& scene)
+void RecalculateGlobalTransforms(Scene& scene, std::vector<u32>* updatedNodes)
 {
-    // Update root node global transform.
-    if (!scene.changedAtThisFrame[0].empty())
-    {
-        int node = scene.changedAtThisFrame[0][0];
-        scene.globalTransforms[node] = scene.localTransforms[node];
-        scene.changedAtThisFrame[0].clear();
-    }
+    const bool depthSorted = IsDepthSorted(scene);
 
-    for (unsigned int i = 1; i < MAX_SCENE_LEVEL && (!scene.changedAtThisFrame[i].empty()); i++)
+    // Nodes of a level only read the global transforms of the level above, so every level can be
+    // split into chunks that are updated in parallel.
+    for (u32 level = 0; level < scene.changedAtThisFrame.size(); level++)
     {
-        for (const auto& node : scene.changedAtThisFrame[i])
+        auto& nodes = scene.changedAtThisFrame[level];
+        if (nodes.empty())
+            continue;
+
+        const bool wholeLevel
+            = depthSorted && level + 1 < scene.levelOffsets.size()
+              && nodes.size() == scene.levelOffsets[level + 1] - scene.levelOffsets[level];
+
+        if (wholeLevel)
         {
-            auto parent = scene.hierarchy[node].parent;
-            scene.globalTransforms[node]
-                = scene.globalTransforms[parent] * scene.localTransforms[node];
+            // Contiguous sweep over the level, parents are a contiguous range as well.
+            const u32 levelBegin = scene.levelOffsets[level];
+            ForEachTransformChunk(nodes.size(), [&](size_t first, size_t count) {
+                for (size_t i = first; i < first + count; i++)
+                    UpdateGlobalTransform(scene, levelBegin + (u32)i);
+            });
         }
-        scene.changedAtThisFrame[i].clear();
+        else
+        {
+            // Visit the nodes in memory order.
+            std::sort(nodes.begin(), nodes.end());
+            ForEachTransformChunk(nodes.size(), [&](size_t first, size_t count) {
+                for (size_t i = first; i < first + count; i++)
+                    UpdateGlobalTransform(scene, nodes[i]);
+            });
+        }
+
+        if (updatedNodes)
+            updatedNodes->insert(updatedNodes->end(), nodes.begin(), nodes.end());
+
+        ClearDirtyNodes(scene, nodes);
     }
 }
 
 void MarkAsChanged(Scene& scene, u32 node)
 {
-    u32 level = scene.hierarchy[node].level;
-    scene.changedAtThisFrame[level].push_back(node);
+    if (scene.dirtyNodes.size() < scene.hierarchy.size())
+        scene.dirtyNodes.resize(scene.hierarchy.size(), false);
+
+    // A dirty node already has its whole subtree queued.
+    if (scene.dirtyNodes[node])
+        return;
 
-    // XXX: Do this iteratively.
-    for (auto s = scene.hierarchy[node].firstChild; s != u32(-1);
-         s = scene.hierarchy[s].nextSibling)
-        MarkAsChanged(scene, s);
+    std::vector<u32> stack{node};
+    while (!stack.empty())
+    {
+        const u32 n = stack.back();
+        stack.pop_back();
+
+        if (scene.dirtyNodes[n])
+            continue;
+
+        const u32 level = scene.hierarchy[n].level;
+        if (level >= scene.changedAtThisFrame.size())
+            scene.changedAtThisFrame.resize(level + 1);
+
+        scene.dirtyNodes[n] = true;
+        scene.changedAtThisFrame[level].push_back(n);
+
+        for (auto s = scene.hierarchy[n].firstChild; s != u32(-1);
+             s = scene.hierarchy[s].nextSibling)
+            stack.push_back(s);
+    }
 }
 
-u32 FindNodeByName(const Scene& scene, const std::string& name)
+void RebuildNameIndex(Scene& scene)
 {
-    // Linear search on each scene id.
-    for (auto i = 0; i < scene.localTransforms.size(); i++)
+    scene.nameFirstNode.assign(scene.names.GetCount(), u32(-1));
+    scene.nameNextNode.assign(scene.nodeNames.size(), u32(-1));
+
+    // Walk backwards and push to the front so the lists end up in ascending node order.
+    for (u32 node = (u32)scene.nodeNames.size(); node-- > 0;)
     {
-        if (scene.namesMap.contains(i))
-        {
-            u32 strID = scene.namesMap.at(i);
-            if (strID != u32(-1))
-                if (scene.names[strID] == name)
-                    return (int)i;
-        }
+        const u32 id = scene.nodeNames[node];
+        if (id == u32(-1))
+            continue;
+
+        scene.nameNextNode[node] = scene.nameFirstNode[id];
+        scene.nameFirstNode[id] = node;
+    }
+}
+
+void SetNodeName(Scene& scene, u32 node, std::string_view name)
+{
+    // Unlink the node from the list of its previous name.
+    const u32 oldId = scene.nodeNames[node];
+    if (oldId != u32(-1))
+    {
+        u32* link = &scene.nameFirstNode[oldId];
+        while (*link != node)
+            link = &scene.nameNextNode[*link];
+        *link = scene.nameNextNode[node];
     }
 
-    return u32(-1);
+    const u32 id = scene.names.Intern(name);
+    if (id >= scene.nameFirstNode.size())
+        scene.nameFirstNode.resize(id + 1, u32(-1));
+
+    u32* link = &scene.nameFirstNode[id];
+    while (*link != u32(-1) && *link < node)
+        link = &scene.nameNextNode[*link];
+
+    scene.nameNextNode[node] = *link;
+    *link = node;
+    scene.nodeNames[node] = id;
+}
+
+mat4 GetLocalTransform(const Scene& scene, u32 node)
+{
+    if (!scene.useTRS)
+        return scene.localTransforms[node];
+
+    mat4 transform;
+    ComposeAffine(scene.localTranslations[node], scene.localRotations[node],
+                  scene.localScales[node], transform);
+    return transform;
+}
+
+void SetLocalTransform(Scene& scene, u32 node, const mat4& transform)
+{
+    if (scene.useTRS)
+        DecomposeAffine(transform, scene.localTranslations[node], scene.localRotations[node],
+                        scene.localScales[node]);
+    else
+        scene.localTransforms[node] = transform;
+}
+
+bool ConvertToTRSLocalTransforms(Scene& scene)
+{
+    if (scene.useTRS)
+        return true;
+
+    if (!std::all_of(std::execution::par, scene.localTransforms.begin(),
+                     scene.localTransforms.end(), IsTRS))
+        return false;
+
+    const size_t nodeCount = scene.localTransforms.size();
+    scene.localTranslations.resize(nodeCount);
+    scene.localRotations.resize(nodeCount);
+    scene.localScales.resize(nodeCount);
+
+    for (size_t node = 0; node < nodeCount; node++)
+        DecomposeAffine(scene.localTransforms[node], scene.localTranslations[node],
+                        scene.localRotations[node], scene.localScales[node]);
+
+    scene.localTransforms = {};
+    scene.useTRS = true;
+
+    return true;
+}
+
+void ConvertToMatrixLocalTransforms(Scene& scene)
+{
+    if (!scene.useTRS)
+        return;
+
+    scene.localTransforms.resize(scene.localTranslations.size());
+    for (u32 node = 0; node < scene.localTransforms.size(); node++)
+        scene.localTransforms[node] = GetLocalTransform(scene, node);
+
+    scene.localTranslations = {};
+    scene.localRotations = {};
+    scene.localScales = {};
+    scene.useTRS = false;
+}
+
+u32 FindNodeByName(const Scene& scene, std::string_view name)
+{
+    const u32 id = scene.names.Find(name);
+    return (id != INVALID_STRING_ID) ? scene.nameFirstNode[id] : u32(-1);
+}
+
+std::vector<u32> FindNodesByName(const Scene& scene, std::string_view name)
+{
+    std::vector<u32> nodes;
+
+    const u32 id = scene.names.Find(name);
+    if (id == INVALID_STRING_ID)
+        return nodes;
+
+    for (u32 node = scene.nameFirstNode[id]; node != u32(-1); node = scene.nameNextNode[node])
+        nodes.push_back(node);
+
+    return nodes;
 }
 
 u32 GetNodeLevel(const Scene& scene, u32 node)
@@ -121,43 +427,402 @@ u32 GetNodeLevel(const Scene& scene, u32 node)
     return level;
 }
 
+void SortSceneByDepth(Scene& scene)
+{
+    const u32 nodeCount = (u32)scene.hierarchy.size();
+
+    // order[newIndex] = oldIndex, built level by level starting from the roots.
+    std::vector<u32> order;
+    order.reserve(nodeCount);
+    for (u32 node = 0; node < nodeCount; node++)
+    {
+        if (scene.hierarchy[node].parent == u32(-1))
+            order.push_back(node);
+    }
+
+    std::vector<u32> levelOffsets = {0};
+    for (size_t levelBegin = 0; levelBegin < order.size();)
+    {
+        const size_t levelEnd = order.size();
+        levelOffsets.push_back((u32)levelEnd);
+
+        for (size_t i = levelBegin; i < levelEnd && order.size() <= nodeCount; i++)
+        {
+            for (auto s = scene.hierarchy[order[i]].firstChild; s != u32(-1);
+                 s = scene.hierarchy[s].nextSibling)
+                order.push_back(s);
+        }
+
+        levelBegin = levelEnd;
+    }
+
+    if (order.size() != nodeCount)
+    {
+        LOG_ERROR("SortSceneByDepth: hierarchy does not reach every node exactly once");
+        scene.levelOffsets.clear();
+        return;
+    }
+
+    const u32 levelCount = (u32)levelOffsets.size() - 1;
+    scene.levelOffsets = std::move(levelOffsets);
+
+    bool identity = true;
+    for (u32 i = 0; i < nodeCount && identity; i++)
+        identity = (order[i] == i);
+
+    if (!identity)
+    {
+        std::vector<u32> newIndices(nodeCount);
+        for (u32 i = 0; i < nodeCount; i++)
+            newIndices[order[i]] = i;
+
+        // Local transform arrays of the unused representation are empty.
+        auto Permute = [&order](auto& items) {
+            if (items.empty())
+                return;
+
+            std::remove_reference_t<decltype(items)> sorted(items.size());
+            for (size_t i = 0; i < order.size(); i++)
+                sorted[i] = items[order[i]];
+            items.swap(sorted);
+        };
+
+        Permute(scene.localTransforms);
+        Permute(scene.localTranslations);
+        Permute(scene.localRotations);
+        Permute(scene.localScales);
+        Permute(scene.globalTransforms);
+        Permute(scene.hierarchy);
+        Permute(scene.nodeMeshes);
+        Permute(scene.nodeMaterials);
+        Permute(scene.nodeNames);
+        RebuildNameIndex(scene);
+
+        auto Remap = [&newIndices](u32 node) {
+            return (node != u32(-1)) ? newIndices[node] : u32(-1);
+        };
+        for (auto& h : scene.hierarchy)
+        {
+            h.parent = Remap(h.parent);
+            h.firstChild = Remap(h.firstChild);
+            h.nextSibling = Remap(h.nextSibling);
+            h.lastSibling = Remap(h.lastSibling);
+        }
+
+        // Pending changes follow their nodes.
+        if (!scene.dirtyNodes.empty())
+        {
+            scene.dirtyNodes.resize(nodeCount, false);
+            Permute(scene.dirtyNodes);
+
+            for (auto& nodes : scene.changedAtThisFrame)
+            {
+                for (auto& node : nodes)
+                    node = (int)newIndices[node];
+            }
+        }
+    }
+
+    for (u32 level = 0; level < levelCount; level++)
+    {
+        for (u32 node = scene.levelOffsets[level]; node < scene.levelOffsets[level + 1]; node++)
+            scene.hierarchy[node].level = level;
+    }
+
+    // Levels may have changed, queue pending changes again.
+    if (!scene.dirtyNodes.empty())
+    {
+        std::vector<int> pending;
+        for (auto& nodes : scene.changedAtThisFrame)
+        {
+            MergeVectors(pending, nodes);
+            nodes.clear();
+        }
+
+        for (const auto node : pending)
+        {
+            const u32 level = scene.hierarchy[node].level;
+            if (level >= scene.changedAtThisFrame.size())
+                scene.changedAtThisFrame.resize(level + 1);
+            scene.changedAtThisFrame[level].push_back(node);
+        }
+    }
+}
+
 /*
  * Scene saving and loading.
  */
-bool SaveScene(const std::string& fileName, Scene& scene)
+namespace
 {
-    std::ofstream file(fileName, std::ios::out | std::ios::binary);
-    if (!file)
+
+constexpr u32 SCENE_FILE_MAGIC_NUMBER = 0x4E43534E; // "NSCN"
+constexpr u32 SCENE_FILE_VERSION = 3;
+
+// Section payloads start at this alignment, enough for SIMD loads of the transforms.
+constexpr u32 SCENE_SECTION_ALIGNMENT = 16;
+
+enum class SceneFileFlags : u32
+{
+    NONE = 0,
+    // Every section stores the CRC-32 of its payload.
+    CHECKSUMS = 1 << 0,
+    // Local transforms are stored as TRS components instead of matrices, added in v3.
+    TRS_LOCAL_TRANSFORMS = 1 << 1,
+};
+
+ENUM_CLASS_FLAG_OPERATORS(SceneFileFlags);
+
+/*
+ * Scene file (v2 and later) layout: header, section table, then the section payloads. Node
+ * indexed sections hold one element per node, u32(-1) for nodes without the component. Unknown
+ * section types are skipped by the loader.
+ */
+struct SceneFileHeader
+{
+    u32 magicNumber;
+    u32 version;
+
+    u32 nodeCount;
+    u32 sectionCount;
+
+    // SceneFileFlags.
+    u32 flags;
+};
+
+enum class SceneSectionType : u32
+{
+    Hierarchy = 0,
+    LocalTransforms = 1,
+    // Only in v2 files, skipped since the global transforms are recalculated on load.
+    GlobalTransforms = 2,
+    NodeMeshes = 3,
+    NodeMaterials = 4,
+    NodeNames = 5,
+    // String blobs.
+    Names = 6,
+    MaterialNames = 7,
+    LevelOffsets = 8,
+    LocalTranslations = 9,
+    LocalRotations = 10,
+    LocalScales = 11,
+};
+
+struct SceneFileSection
+{
+    SceneSectionType type;
+
+    u32 elementSize;
+    u32 elementCount;
+
+    u32 fileOffset;
+    u32 fileSize;
+
+    u32 checksum;
+};
+
+struct SceneSectionPayload
+{
+    SceneFileSection section;
+    const void* data;
+};
+
+constexpr u32 AlignSectionOffset(u32 offset)
+{
+    return (offset + SCENE_SECTION_ALIGNMENT - 1) & ~(SCENE_SECTION_ALIGNMENT - 1);
+}
+
+template <typename T>
+SceneSectionPayload CreateSection(SceneSectionType type, const std::vector<T>& data)
+{
+    return {
+        .section = {
+            .type = type,
+            .elementSize = sizeof(T),
+            .elementCount = (u32)data.size(),
+            .fileOffset = 0,
+            .fileSize = (u32)(sizeof(T) * data.size()),
+            .checksum = 0,
+        },
+        .data = data.data(),
+    };
+}
+
+template <typename T>
+bool SetSectionSpan(std::span<const T>& span, const SceneFileSection& section,
+                    const MappedFile& file)
+{
+    if (section.elementSize != sizeof(T)
+        || (size_t)section.elementCount * section.elementSize != section.fileSize
+        || (size_t)section.fileOffset + section.fileSize > file.GetSize()
+        || section.fileOffset % alignof(T) != 0)
+        return false;
+
+    span = {reinterpret_cast<const T*>(file.GetData() + section.fileOffset),
+            section.elementCount};
+    return true;
+}
+
+/*
+ * Links pointing outside the scene would send every hierarchy walk out of bounds.
+ */
+bool IsValidHierarchy(std::span<const SceneHierarchy> hierarchy)
+{
+    const u32 nodeCount = (u32)hierarchy.size();
+    const auto isValidLink = [nodeCount](u32 node) { return node == u32(-1) || node < nodeCount; };
+
+    return std::all_of(hierarchy.begin(), hierarchy.end(), [&](const SceneHierarchy& h) {
+        return isValidLink(h.parent) && isValidLink(h.firstChild) && isValidLink(h.nextSibling)
+               && isValidLink(h.lastSibling);
+    });
+}
+
+bool IsValidLevelOffsets(std::span<const u32> levelOffsets, u32 nodeCount)
+{
+    return levelOffsets.empty()
+           || (levelOffsets.front() == 0 && levelOffsets.back() == nodeCount
+               && std::is_sorted(levelOffsets.begin(), levelOffsets.end()));
+}
+
+bool IsValidStringBlob(std::span<const char> blob)
+{
+    return blob.empty() || blob.back() == '\0';
+}
+
+bool IsSceneFile(const MappedFile& file)
+{
+    u32 magicNumber = 0;
+    if (file.GetSize() >= sizeof(magicNumber))
+        memcpy(&magicNumber, file.GetData(), sizeof(magicNumber));
+
+    return magicNumber == SCENE_FILE_MAGIC_NUMBER;
+}
+
+bool LoadSceneSections(SceneDataView& sceneData, const std::string& fileName)
+{
+    const u8* data = sceneData.file.GetData();
+    const size_t fileSize = sceneData.file.GetSize();
+
+    SceneFileHeader header;
+    if (fileSize < sizeof(header))
     {
-        LOG_ERROR("saveScene: failed to open file ", fs::absolute(fileName));
+        LOG_ERROR("LoadScene: ", fileName, " is truncated");
         return false;
     }
+    memcpy(&header, data, sizeof(header));
 
-    const u32 nodeCount = (u32)scene.hierarchy.size();
-    file.write((const char*)&nodeCount, sizeof(nodeCount));
+    if (header.version < 2 || header.version > SCENE_FILE_VERSION)
+    {
+        LOG_ERROR("LoadScene: ", fileName, " has unsupported version ", header.version);
+        return false;
+    }
 
-    file.write((const char*)scene.localTransforms.data(), sizeof(mat4) * nodeCount);
-    file.write((const char*)scene.globalTransforms.data(), sizeof(mat4) * nodeCount);
-    file.write((const char*)scene.hierarchy.data(), sizeof(SceneHierarchy) * nodeCount);
+    if (sizeof(header) + sizeof(SceneFileSection) * (size_t)header.sectionCount > fileSize)
+    {
+        LOG_ERROR("LoadScene: ", fileName, " is truncated");
+        return false;
+    }
 
-    SaveMap(file, scene.materialsMap);
-    SaveMap(file, scene.meshesMap);
+    const auto flags = SceneFileFlags(header.flags);
+    const bool checksums = !!(flags & SceneFileFlags::CHECKSUMS);
+    sceneData.useTRS = !!(flags & SceneFileFlags::TRS_LOCAL_TRANSFORMS);
 
-    if (!scene.names.empty() && !scene.namesMap.empty())
+    for (u32 i = 0; i < header.sectionCount; i++)
     {
-        SaveMap(file, scene.namesMap);
-        SaveStringArray(file, scene.names);
-        SaveStringArray(file, scene.materialNames);
+        SceneFileSection section;
+        memcpy(&section, data + sizeof(header) + sizeof(section) * i, sizeof(section));
+
+        bool valid = true;
+        switch (section.type)
+        {
+        case SceneSectionType::Hierarchy:
+            valid = SetSectionSpan(sceneData.hierarchy, section, sceneData.file);
+            break;
+        case SceneSectionType::LocalTransforms:
+            valid = SetSectionSpan(sceneData.localTransforms, section, sceneData.file);
+            break;
+        case SceneSectionType::LocalTranslations:
+            valid = SetSectionSpan(sceneData.localTranslations, section, sceneData.file);
+            break;
+        case SceneSectionType::LocalRotations:
+            valid = SetSectionSpan(sceneData.localRotations, section, sceneData.file);
+            break;
+        case SceneSectionType::LocalScales:
+            valid = SetSectionSpan(sceneData.localScales, section, sceneData.file);
+            break;
+        case SceneSectionType::NodeMeshes:
+            valid = SetSectionSpan(sceneData.nodeMeshes, section, sceneData.file);
+            break;
+        case SceneSectionType::NodeMaterials:
+            valid = SetSectionSpan(sceneData.nodeMaterials, section, sceneData.file);
+            break;
+        case SceneSectionType::NodeNames:
+            valid = SetSectionSpan(sceneData.nodeNames, section, sceneData.file);
+            break;
+        case SceneSectionType::Names:
+            valid = SetSectionSpan(sceneData.names, section, sceneData.file);
+            break;
+        case SceneSectionType::MaterialNames:
+            valid = SetSectionSpan(sceneData.materialNames, section, sceneData.file);
+            break;
+        case SceneSectionType::LevelOffsets:
+            valid = SetSectionSpan(sceneData.levelOffsets, section, sceneData.file);
+            break;
+        default:
+            continue;
+        }
+
+        if (!valid)
+        {
+            LOG_ERROR("LoadScene: ", fileName, " has an invalid section ", (u32)section.type);
+            return false;
+        }
+
+        if (checksums && Crc32(data + section.fileOffset, section.fileSize) != section.checksum)
+        {
+            LOG_ERROR("LoadScene: ", fileName, " section ", (u32)section.type,
+                      " is corrupted, checksum mismatch");
+            return false;
+        }
     }
 
-    file.close();
+    const u32 nodeCount = header.nodeCount;
+    const auto isNodeSection = [nodeCount](auto span) { return span.size() == nodeCount; };
+    const auto isOptionalNodeSection
+        = [nodeCount](auto span) { return span.empty() || span.size() == nodeCount; };
+
+    const bool hasLocalTransforms
+        = sceneData.useTRS ? isNodeSection(sceneData.localTranslations)
+                                 && isNodeSection(sceneData.localRotations)
+                                 && isNodeSection(sceneData.localScales)
+                           : isNodeSection(sceneData.localTransforms);
+
+    if (!isNodeSection(sceneData.hierarchy) || !hasLocalTransforms
+        || !isNodeSection(sceneData.nodeMeshes) || !isNodeSection(sceneData.nodeMaterials)
+        || !isOptionalNodeSection(sceneData.nodeNames))
+    {
+        LOG_ERROR("LoadScene: ", fileName, " is missing node data");
+        return false;
+    }
+
+    if (!IsValidHierarchy(sceneData.hierarchy)
+        || !IsValidLevelOffsets(sceneData.levelOffsets, nodeCount)
+        || !IsValidStringBlob(sceneData.names) || !IsValidStringBlob(sceneData.materialNames))
+    {
+        LOG_ERROR("LoadScene: ", fileName, " has invalid scene data");
+        return false;
+    }
 
     return true;
 }
 
-bool LoadScene(const std::string& fileName, Scene& scene)
+/*
+ * Unversioned layout: node count, local and global transforms and hierarchy, then the material
+ * and mesh components as (node, value) pairs. Scenes with names continue with the node name
+ * components and two string arrays, the node names and the material names.
+ */
+bool LoadLegacyScene(const std::string& fileName, Scene& scene)
 {
-    std::ifstream file(fileName, std::ios::out | std::ios::binary);
+    std::ifstream file(fileName, std::ios::in | std::ios::binary);
 
     if (!file)
     {
@@ -171,26 +836,61 @@ bool LoadScene(const std::string& fileName, Scene& scene)
     scene.hierarchy.resize(size);
     scene.globalTransforms.resize(size);
     scene.localTransforms.resize(size);
-
-    /*
-     * XXX:
-     *   - Check that scene nodes are valid / not u32(-1)
-     *   - Recalculate ChangedAtThisLevel / find max depth of a node, or cache max level/depth
-     * somewhere.
-     */
+    scene.localTranslations = {};
+    scene.localRotations = {};
+    scene.localScales = {};
+    scene.useTRS = false;
+    scene.nodeMeshes.assign(size, u32(-1));
+    scene.nodeMaterials.assign(size, u32(-1));
+    scene.nodeNames.assign(size, u32(-1));
+    scene.names.Clear();
+    scene.materialNames.clear();
+
+    // Derived state of a scene loaded before must not survive, stale levelOffsets would mark the
+    // new nodes as depth sorted.
+    scene.levelOffsets.clear();
+    scene.changedAtThisFrame.clear();
+    scene.dirtyNodes.clear();
+    scene.nameFirstNode.clear();
+    scene.nameNextNode.clear();
 
     file.read((char*)scene.localTransforms.data(), sizeof(mat4) * size);
     file.read((char*)scene.globalTransforms.data(), sizeof(mat4) * size);
     file.read((char*)scene.hierarchy.data(), sizeof(SceneHierarchy) * size);
 
-    LoadMap(file, scene.materialsMap);
-    LoadMap(file, scene.meshesMap);
+    LoadComponentArray(file, scene.nodeMaterials);
+    LoadComponentArray(file, scene.nodeMeshes);
 
-    if (!file.eof())
+    // Names were only written for scenes that have them. Node names are indices into a string
+    // array that may hold duplicates, they are interned and the indices remapped to the ids.
+    if (file.peek() == std::ifstream::traits_type::eof())
     {
-        LoadMap(file, scene.namesMap);
-        LoadStringArray(file, scene.names);
+        // Reaching the end is not a read error here.
+        file.clear();
+    }
+    else
+    {
+        std::vector<std::string> names;
+        LoadComponentArray(file, scene.nodeNames);
+        LoadStringArray(file, names);
         LoadStringArray(file, scene.materialNames);
+
+        std::vector<u32> nameIds(names.size());
+        for (size_t i = 0; i < names.size(); i++)
+            nameIds[i] = scene.names.Intern(names[i]);
+
+        for (auto& name : scene.nodeNames)
+        {
+            if (name == u32(-1))
+                continue;
+
+            if (name >= nameIds.size())
+            {
+                LOG_ERROR("loadScene: node name out of range - ", fileName);
+                return false;
+            }
+            name = nameIds[name];
+        }
     }
 
     if (!file.good())
@@ -199,11 +899,211 @@ bool LoadScene(const std::string& fileName, Scene& scene)
         return false;
     }
 
+    if (!IsValidHierarchy(scene.hierarchy))
+    {
+        LOG_ERROR("loadScene: invalid scene hierarchy - ", fileName);
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool SaveScene(const std::string& fileName, const Scene& scene, bool checksums)
+{
+    std::ofstream file(fileName, std::ios::out | std::ios::binary);
+    if (!file)
+    {
+        LOG_ERROR("saveScene: failed to open file ", fs::absolute(fileName));
+        return false;
+    }
+
+    std::vector<char> materialNames;
+    for (const auto& name : scene.materialNames)
+        materialNames.insert(materialNames.end(), name.c_str(), name.c_str() + name.size() + 1);
+
+    std::vector<SceneSectionPayload> sections = {
+        CreateSection(SceneSectionType::Hierarchy, scene.hierarchy),
+        CreateSection(SceneSectionType::NodeMeshes, scene.nodeMeshes),
+        CreateSection(SceneSectionType::NodeMaterials, scene.nodeMaterials),
+    };
+
+    if (scene.useTRS)
+    {
+        sections.push_back(
+            CreateSection(SceneSectionType::LocalTranslations, scene.localTranslations));
+        sections.push_back(CreateSection(SceneSectionType::LocalRotations, scene.localRotations));
+        sections.push_back(CreateSection(SceneSectionType::LocalScales, scene.localScales));
+    }
+    else
+    {
+        sections.push_back(CreateSection(SceneSectionType::LocalTransforms, scene.localTransforms));
+    }
+
+    if (!scene.names.IsEmpty())
+    {
+        sections.push_back(CreateSection(SceneSectionType::NodeNames, scene.nodeNames));
+        sections.push_back(CreateSection(SceneSectionType::Names, scene.names.GetBlob()));
+    }
+
+    if (!materialNames.empty())
+        sections.push_back(CreateSection(SceneSectionType::MaterialNames, materialNames));
+
+    // Lets the loader skip SortSceneByDepth.
+    if (IsDepthSorted(scene))
+        sections.push_back(CreateSection(SceneSectionType::LevelOffsets, scene.levelOffsets));
+
+    const SceneFileHeader header = {
+        .magicNumber = SCENE_FILE_MAGIC_NUMBER,
+        .version = SCENE_FILE_VERSION,
+        .nodeCount = (u32)scene.hierarchy.size(),
+        .sectionCount = (u32)sections.size(),
+        .flags = (u32)((checksums ? SceneFileFlags::CHECKSUMS : SceneFileFlags::NONE)
+                       | (scene.useTRS ? SceneFileFlags::TRS_LOCAL_TRANSFORMS
+                                       : SceneFileFlags::NONE)),
+    };
+
+    u32 fileOffset
+        = AlignSectionOffset(sizeof(SceneFileHeader) + sizeof(SceneFileSection) * sections.size());
+    for (auto& payload : sections)
+    {
+        payload.section.fileOffset = fileOffset;
+        fileOffset = AlignSectionOffset(fileOffset + payload.section.fileSize);
+
+        if (checksums)
+            payload.section.checksum = Crc32(payload.data, payload.section.fileSize);
+    }
+
+    file.write((const char*)&header, sizeof(header));
+    for (const auto& payload : sections)
+        file.write((const char*)&payload.section, sizeof(SceneFileSection));
+
+    const char padding[SCENE_SECTION_ALIGNMENT] = {};
+    for (const auto& payload : sections)
+    {
+        const u32 offset = (u32)file.tellp();
+        file.write(padding, payload.section.fileOffset - offset);
+        file.write((const char*)payload.data, payload.section.fileSize);
+    }
+
+    if (!file.good())
+    {
+        LOG_ERROR("saveScene: failed to write scene data - ", fileName);
+        return false;
+    }
+
     file.close();
 
     return true;
 }
 
+bool LoadScene(const std::string& fileName, SceneDataView& sceneData)
+{
+    sceneData = SceneDataView();
+
+    if (!sceneData.file.Open(fileName))
+    {
+        LOG_ERROR("LoadScene: failed to open ", fs::absolute(fileName));
+        return false;
+    }
+
+    if (!IsSceneFile(sceneData.file))
+    {
+        LOG_ERROR("LoadScene: ", fileName, " is not a versioned scene file");
+        sceneData = SceneDataView();
+        return false;
+    }
+
+    if (!LoadSceneSections(sceneData, fileName))
+    {
+        sceneData = SceneDataView();
+        return false;
+    }
+
+    return true;
+}
+
+bool LoadScene(const std::string& fileName, Scene& scene)
+{
+    SceneDataView sceneData;
+    if (!sceneData.file.Open(fileName))
+    {
+        LOG_ERROR("LoadScene: failed to open ", fs::absolute(fileName));
+        return false;
+    }
+
+    if (!IsSceneFile(sceneData.file))
+    {
+        sceneData.file.Close();
+        if (!LoadLegacyScene(fileName, scene))
+            return false;
+    }
+    else
+    {
+        if (!LoadSceneSections(sceneData, fileName))
+            return false;
+
+        const auto assign = [](auto& dst, auto src) { dst.assign(src.begin(), src.end()); };
+        const u32 nodeCount = (u32)sceneData.hierarchy.size();
+
+        assign(scene.hierarchy, sceneData.hierarchy);
+        assign(scene.localTransforms, sceneData.localTransforms);
+        assign(scene.localTranslations, sceneData.localTranslations);
+        assign(scene.localRotations, sceneData.localRotations);
+        assign(scene.localScales, sceneData.localScales);
+        scene.useTRS = sceneData.useTRS;
+        scene.globalTransforms.resize(nodeCount);
+        assign(scene.nodeMeshes, sceneData.nodeMeshes);
+        assign(scene.nodeMaterials, sceneData.nodeMaterials);
+        assign(scene.levelOffsets, sceneData.levelOffsets);
+
+        if (!sceneData.nodeNames.empty())
+            assign(scene.nodeNames, sceneData.nodeNames);
+        else
+            scene.nodeNames.assign(nodeCount, u32(-1));
+
+        if (!scene.names.Assign(std::vector<char>(sceneData.names.begin(), sceneData.names.end())))
+        {
+            LOG_ERROR("LoadScene: invalid node names - ", fileName);
+            return false;
+        }
+
+        scene.materialNames.clear();
+        for (size_t offset = 0; offset < sceneData.materialNames.size();)
+        {
+            scene.materialNames.emplace_back(&sceneData.materialNames[offset]);
+            offset += scene.materialNames.back().size() + 1;
+        }
+    }
+
+    for (const auto id : scene.nodeNames)
+    {
+        if (id != u32(-1) && id >= scene.names.GetCount())
+        {
+            LOG_ERROR("LoadScene: node name out of range - ", fileName);
+            return false;
+        }
+    }
+
+    scene.changedAtThisFrame.clear();
+    scene.dirtyNodes.clear();
+
+    // Legacy files and scenes saved unsorted are reordered here.
+    if (!IsDepthSorted(scene))
+        SortSceneByDepth(scene);
+    RebuildNameIndex(scene);
+
+    // Roots come first in depth sorted scenes. Marking them dirties every node, so each level is
+    // swept as one range.
+    for (u32 root = 0; root < scene.hierarchy.size() && scene.hierarchy[root].parent == u32(-1);
+         root++)
+        MarkAsChanged(scene, root);
+    RecalculateGlobalTransforms(scene);
+
+    return true;
+}
+
 /*
  * More advanced scene operations.
  */
@@ -230,50 +1130,27 @@ void ShiftNodes(Scene& scene, u32 startOffset, u32 nodeCount, u32 shiftAmount)
         ShiftNode(scene.hierarchy[i + startOffset]);
 }
 
-using ItemMap = std::unordered_map<u32, u32>;
-void MergeMaps(ItemMap& m, const ItemMap& otherMap, int indexOffset, int itemOffset)
-{
-    for (const auto& i : otherMap)
-        m[i.first + indexOffset] = i.second + itemOffset;
-}
-
-void AddUniqueIndex(std::vector<u32>& v, u32 index)
-{
-    if (!std::binary_search(v.begin(), v.end(), index))
-        v.push_back(index);
-}
-
-// Recurse down the tree and add nodes to delete.
-void CollectNodesToDelete(const Scene& scene, u32 node, std::vector<u32>& nodes)
+/*
+ * Appends the components of the merged scene, nodes keep their order so only the component values
+ * need an offset.
+ */
+void MergeComponents(std::vector<u32>& components, const std::vector<u32>& otherComponents,
+                     u32 itemOffset)
 {
-    for (int n = scene.hierarchy[node].firstChild; n != u32(-1); n = scene.hierarchy[n].nextSibling)
-    {
-        AddUniqueIndex(nodes, n);
-        CollectNodesToDelete(scene, n, nodes);
-    }
+    const size_t start = components.size();
+    components.resize(start + otherComponents.size());
+    std::transform(otherComponents.begin(), otherComponents.end(), components.begin() + start,
+                   [itemOffset](u32 item) { return (item != u32(-1)) ? item + itemOffset : item; });
 }
 
-u32 FindLastNonDeletedItem(const Scene& scene, const std::vector<u32>& newIndices, u32 node)
+// Same as MergeComponents with a lookup table instead of an offset.
+void RemapComponents(std::vector<u32>& components, const std::vector<u32>& otherComponents,
+                     const std::vector<u32>& remap)
 {
-    if (node == u32(-1))
-        return u32(-1);
-
-    return (newIndices[node] == u32(-1))
-               ? FindLastNonDeletedItem(scene, newIndices, scene.hierarchy[node].nextSibling)
-               : newIndices[node];
-}
-
-// Set map values based on newIndices.
-void ShiftMapIndices(std::unordered_map<u32, u32>& items, const std::vector<u32>& newIndices)
-{
-    std::unordered_map<u32, u32> newItems;
-    for (const auto& m : items)
-    {
-        int newIndex = newIndices[m.first];
-        if (newIndex != u32(-1))
-            newItems[newIndex] = m.second;
-    }
-    items = newItems;
+    const size_t start = components.size();
+    components.resize(start + otherComponents.size());
+    std::transform(otherComponents.begin(), otherComponents.end(), components.begin() + start,
+                   [&remap](u32 item) { return (item != u32(-1)) ? remap[item] : item; });
 }
 
 } // namespace
@@ -291,19 +1168,40 @@ void MergeScenes(Scene& scene, const std::vector<Scene*>& scenes,
         .level = 0,
     }};
 
-    scene.namesMap[0] = 0;
-    scene.names = {"NewRootNode"};
+    scene.nodeMeshes = {u32(-1)};
+    scene.nodeMaterials = {u32(-1)};
+    scene.names.Clear();
+    scene.nodeNames = {scene.names.Intern("NewRootNode")};
 
-    scene.localTransforms.push_back(glm::mat4(1.f));
-    scene.globalTransforms.push_back(glm::mat4(1.f));
+    scene.useTRS = !scenes.empty()
+                   && std::all_of(scenes.begin(), scenes.end(),
+                                  [](const Scene* s) { return s->useTRS; });
+    if (scene.useTRS)
+    {
+        scene.localTransforms = {};
+        scene.localTranslations = {vec3(0.0f)};
+        scene.localRotations = {quat(1.0f, 0.0f, 0.0f, 0.0f)};
+        scene.localScales = {vec3(1.0f)};
+    }
+    else
+    {
+        scene.localTransforms = {glm::mat4(1.f)};
+        scene.localTranslations = {};
+        scene.localRotations = {};
+        scene.localScales = {};
+    }
+    scene.globalTransforms = {glm::mat4(1.f)};
 
     if (scenes.empty())
+    {
+        RebuildNameIndex(scene);
         return;
+    }
 
     int offs = 1;
     int meshOffs = 0;
-    int nameOffs = (int)scene.names.size();
     int materialOfs = 0;
+    std::vector<u32> nameRemap;
     auto meshCount = meshCounts.begin();
 
     if (!mergeMaterials)
@@ -311,12 +1209,26 @@ void MergeScenes(Scene& scene, const std::vector<Scene*>& scenes,
 
     for (const auto* s : scenes)
     {
-        MergeVectors(scene.localTransforms, s->localTransforms);
+        if (scene.useTRS)
+        {
+            MergeVectors(scene.localTranslations, s->localTranslations);
+            MergeVectors(scene.localRotations, s->localRotations);
+            MergeVectors(scene.localScales, s->localScales);
+        }
+        else
+        {
+            for (u32 node = 0; node < s->hierarchy.size(); node++)
+                scene.localTransforms.push_back(GetLocalTransform(*s, node));
+        }
         MergeVectors(scene.globalTransforms, s->globalTransforms);
 
         MergeVectors(scene.hierarchy, s->hierarchy);
 
-        MergeVectors(scene.names, s->names);
+        // Names shared between scenes are stored once.
+        nameRemap.resize(s->names.GetCount());
+        for (u32 i = 0; i < nameRemap.size(); i++)
+            nameRemap[i] = scene.names.Intern(s->names.Get(i));
+
         if (mergeMaterials)
             MergeVectors(scene.materialNames, s->materialNames);
 
@@ -324,14 +1236,13 @@ void MergeScenes(Scene& scene, const std::vector<Scene*>& scenes,
 
         ShiftNodes(scene, offs, nodeCount, offs);
 
-        MergeMaps(scene.meshesMap, s->meshesMap, offs, mergeMeshes ? meshOffs : 0);
-        MergeMaps(scene.materialsMap, s->materialsMap, offs, mergeMaterials ? materialOfs : 0);
-        MergeMaps(scene.namesMap, s->namesMap, offs, nameOffs);
+        MergeComponents(scene.nodeMeshes, s->nodeMeshes, mergeMeshes ? meshOffs : 0);
+        MergeComponents(scene.nodeMaterials, s->nodeMaterials, mergeMaterials ? materialOfs : 0);
+        RemapComponents(scene.nodeNames, s->nodeNames, nameRemap);
 
         offs += nodeCount;
 
         materialOfs += (int)s->materialNames.size();
-        nameOffs += (int)s->names.size();
 
         if (mergeMeshes)
         {
@@ -353,7 +1264,7 @@ void MergeScenes(Scene& scene, const std::vector<Scene*>& scenes,
         scene.hierarchy[offs].parent = 0;
 
         if (!rootTransforms.empty())
-            scene.localTransforms[offs] = rootTransforms[idx] * scene.localTransforms[offs];
+            SetLocalTransform(scene, offs, rootTransforms[idx] * GetLocalTransform(scene, offs));
 
         offs += nodeCount;
         idx++;
@@ -361,68 +1272,17 @@ void MergeScenes(Scene& scene, const std::vector<Scene*>& scenes,
 
     for (auto i = scene.hierarchy.begin() + 1; i != scene.hierarchy.end(); i++)
         i->level++;
+
+    SortSceneByDepth(scene);
+    RebuildNameIndex(scene);
 }
 
-/*
- * Approximately an O ( N * Log(N) * Log(M)) algorithm (N = scene.size, M = nodesToDelete.size) to
- * delete a collection of nodes. See:
- * https://github.com/PacktPublishing/3D-Graphics-Rendering-Cookbook/blob/master/shared/scene/Scene.cpp
- */
 void DeleteSceneNodes(Scene& scene, const std::vector<u32>& nodesToDelete)
 {
-    // 0) Add all the nodes down below in the hierarchy
-    auto indicesToDelete = nodesToDelete;
-    for (auto i : indicesToDelete)
-        CollectNodesToDelete(scene, i, indicesToDelete);
-
-    // aux array with node indices to keep track of the moved ones [moved = [](node) { return (node
-    // != nodes[node]); ]
-    std::vector<u32> nodes(scene.hierarchy.size());
-    std::iota(nodes.begin(), nodes.end(), 0);
-
-    // 1.a) Move all the indicesToDelete to the end of 'nodes' array (and cut them off, a variation
-    // of swap'n'pop for multiple elements)
-    auto oldSize = nodes.size();
-    EraseSelected(nodes, indicesToDelete);
-
-    // 1.b) Make a newIndices[oldIndex] mapping table
-    std::vector<u32> newIndices(oldSize, u32(-1));
-    for (int i = 0; i < nodes.size(); i++)
-        newIndices[nodes[i]] = i;
-
-    // 2) Replace all non-null parent/firstChild/nextSibling pointers in all the nodes by new
-    // positions
-    auto nodeMover = [&scene, &newIndices](SceneHierarchy& h) {
-        return SceneHierarchy{
-            .parent = (h.parent != u32(-1)) ? newIndices[h.parent] : u32(-1),
-            .firstChild = FindLastNonDeletedItem(scene, newIndices, h.firstChild),
-            .nextSibling = FindLastNonDeletedItem(scene, newIndices, h.nextSibling),
-            .lastSibling = FindLastNonDeletedItem(scene, newIndices, h.lastSibling)};
-    };
-    std::transform(scene.hierarchy.begin(), scene.hierarchy.end(), scene.hierarchy.begin(),
-                   nodeMover);
-
-    // 3) Finally throw away the hierarchy items
-    EraseSelected(scene.hierarchy, indicesToDelete);
-
-    // 4) As in mergeScenes() routine we also have to adjust all the "components" (i.e., meshesMap,
-    // materials, names and transformations)
-
-    // 4a) Transformations are stored in arrays, so we just erase the items as we did with the
-    // scene.hierarchy
-    EraseSelected(scene.localTransforms, indicesToDelete);
-    EraseSelected(scene.globalTransforms, indicesToDelete);
-
-    // 4b) All the maps should change the key values with the newIndices[] array
-    ShiftMapIndices(scene.meshesMap, newIndices);
-    ShiftMapIndices(scene.materialsMap, newIndices);
-    ShiftMapIndices(scene.namesMap, newIndices);
-
-    // 5) scene node names list is not modified, but in principle it can be (remove all non-used
-    // items and adjust the namesMap map)
-
-    // 6) Material names list is not modified also, but if some
-    // materials fell out of use, remove them completely.
+    SceneEditor editor(scene);
+    for (const auto node : nodesToDelete)
+        editor.DeleteNode(node);
+    editor.Commit();
 }
 
 } // namespace Nerine
@@ -1,16 +1,16 @@
 #pragma once
 
+#include <Core/MappedFile.h>
+#include <Core/StringTable.h>
 #include <Core/Types.h>
 
-#include <unordered_map>
+#include <span>
 #include <vector>
 #include <string>
 
 namespace Nerine
 {
 
-constexpr auto MAX_SCENE_LEVEL = 16;
-
 struct SceneHierarchy
 {
     u32 parent{u32(-1)};
@@ -23,47 +23,158 @@ struct SceneHierarchy
 // XXX: Use handle/strong typed ints for scene/node indices.
 struct Scene
 {
+    // Local transforms of every node, empty when the scene uses TRS local transforms.
     std::vector<mat4> localTransforms;
+
+    // Local transforms as translation * rotation * scale, one array per component, used instead
+    // of localTransforms when useTRS is set. They are only composed into matrices while the
+    // global transforms are propagated, see ConvertToTRSLocalTransforms.
+    std::vector<vec3> localTranslations;
+    std::vector<quat> localRotations;
+    std::vector<vec3> localScales;
+    bool useTRS{false};
+
+    // Not saved, LoadScene recalculates them.
     std::vector<mat4> globalTransforms;
 
     std::vector<SceneHierarchy> hierarchy;
 
-    std::unordered_map<u32, u32> meshesMap;
-    std::unordered_map<u32, u32> materialsMap;
-    std::unordered_map<u32, u32> namesMap;
+    // Components, indexed by node like the hierarchy. u32(-1) marks a node without the
+    // component.
+    std::vector<u32> nodeMeshes;
+    std::vector<u32> nodeMaterials;
+    std::vector<u32> nodeNames;
 
-    std::vector<std::string> names;
+    // Node names, nodeNames holds ids into this table.
+    StringTable names;
     std::vector<std::string> materialNames;
 
-    std::vector<int> changedAtThisFrame[MAX_SCENE_LEVEL];
+    // Name to node index: first node per name id, then the next node with the same name per node,
+    // both u32(-1) terminated and in ascending node order. Kept up to date by SetNodeName,
+    // LoadScene, MergeScenes, SceneEditor and SortSceneByDepth.
+    std::vector<u32> nameFirstNode;
+    std::vector<u32> nameNextNode;
+
+    // First node of every level followed by the node count, valid while the nodes are stored in
+    // breadth first (depth sorted) order so that every level is a contiguous node range. Empty
+    // otherwise, see SortSceneByDepth.
+    std::vector<u32> levelOffsets;
+
+    // Changed nodes per level, grows with the deepest changed level.
+    std::vector<std::vector<int>> changedAtThisFrame;
+
+    // Set for every node queued in changedAtThisFrame, so a node is queued at most once per
+    // update. Grown on demand by MarkAsChanged.
+    std::vector<bool> dirtyNodes;
 };
 
 inline std::string GetNodeName(const Scene& scene, u32 node)
 {
-    u32 id = scene.namesMap.contains(node) ? scene.namesMap.at(node) : u32(-1);
-    return (id > u32(-1)) ? scene.names[id] : std::string();
+    u32 id = scene.nodeNames[node];
+    return (id != u32(-1)) ? std::string(scene.names.Get(id)) : std::string();
 }
 
-inline void SetNodeName(Scene& scene, u32 node, const std::string& name)
-{
-    u32 id = (u32)scene.names.size();
-    scene.names.push_back(name);
-    scene.namesMap[node] = id;
-}
+void SetNodeName(Scene& scene, u32 node, std::string_view name);
+
+// Rebuilds nameFirstNode/nameNextNode from nodeNames.
+void RebuildNameIndex(Scene& scene);
 
+mat4 GetLocalTransform(const Scene& scene, u32 node);
+
+/*
+ * Sets the local transform of the node without marking it as changed. TRS scenes store the
+ * decomposed matrix, so shear and projection are lost there.
+ */
+void SetLocalTransform(Scene& scene, u32 node, const mat4& transform);
+
+/*
+ * Switches the scene to TRS local transforms. Returns false and keeps the matrices if a local
+ * transform is not a translation, rotation and scale.
+ */
+bool ConvertToTRSLocalTransforms(Scene& scene);
+void ConvertToMatrixLocalTransforms(Scene& scene);
+
+/*
+ * Appends a node. The scene stays depth sorted as long as nodes are added level by level.
+ */
 u32 AddNode(Scene& scene, u32 parent, u32 level);
-void RecalculateGlobalTransforms(Scene& scene);
 
+/*
+ * Updates the global transforms of the nodes queued by MarkAsChanged. The updated nodes are
+ * appended to updatedNodes if given, e.g. to sync the GPU copies of only what moved.
+ */
+void RecalculateGlobalTransforms(Scene& scene, std::vector<u32>* updatedNodes = nullptr);
+
+/*
+ * Reorders the nodes breadth first, so every level is a contiguous node range and parents come
+ * before their children, then recalculates node levels and levelOffsets. Siblings keep their
+ * order. Node indices change unless the scene already was in this order.
+ */
+void SortSceneByDepth(Scene& scene);
+
+/*
+ * The merged scene uses TRS local transforms if all scenes do.
+ */
 void MergeScenes(Scene& scene, const std::vector<Scene*>& scenes,
                  const std::vector<mat4>& rootTransforms, const std::vector<u32>& meshCounts,
                  bool mergeMeshes = true, bool mergeMaterials = true);
+/*
+ * Deletes the nodes and their subtrees, see SceneEditor for batching other edits with it.
+ */
 void DeleteSceneNodes(Scene& scene, const std::vector<u32>& nodesToDelete);
 
 void MarkAsChanged(Scene& scene, u32 node);
-u32 FindNodeByName(const Scene& scene, const std::string& name);
+/*
+ * Returns the first node with the name or u32(-1).
+ */
+u32 FindNodeByName(const Scene& scene, std::string_view name);
+std::vector<u32> FindNodesByName(const Scene& scene, std::string_view name);
 u32 GetNodeLevel(const Scene& scene, u32 node);
 
-bool SaveScene(const std::string& fileName, Scene& scene);
+/*
+ * Read-only view of a scene file, the spans point straight into the memory mapped file. Optional
+ * sections that are not in the file are empty, levelOffsets is only stored for depth sorted
+ * scenes.
+ */
+struct SceneDataView
+{
+    std::span<const SceneHierarchy> hierarchy;
+
+    // Either the matrices or the TRS components are stored, see Scene::useTRS.
+    std::span<const mat4> localTransforms;
+    std::span<const vec3> localTranslations;
+    std::span<const quat> localRotations;
+    std::span<const vec3> localScales;
+    bool useTRS{false};
+
+    std::span<const u32> nodeMeshes;
+    std::span<const u32> nodeMaterials;
+    std::span<const u32> nodeNames;
+    std::span<const u32> levelOffsets;
+
+    // Null terminated strings back to back, see StringTable::GetBlob.
+    std::span<const char> names;
+    std::span<const char> materialNames;
+
+    // Backing storage of the spans above.
+    MappedFile file;
+};
+
+/*
+ * Writes the scene in the current (v3) format, with checksums every section gets a CRC-32 that
+ * is verified when loading. Global transforms are not stored.
+ */
+bool SaveScene(const std::string& fileName, const Scene& scene, bool checksums = false);
+
+/*
+ * Loads v2 and later scene files and the unversioned files written before them, then calculates
+ * the global transforms.
+ */
 bool LoadScene(const std::string& fileName, Scene& scene);
 
+/*
+ * Maps a v2 or later scene file without copying it, older files have to be loaded into a Scene.
+ */
+bool LoadScene(const std::string& fileName, SceneDataView& sceneData);
+
 } // namespace Nerine
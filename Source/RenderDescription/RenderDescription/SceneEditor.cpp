@@ -0,0 +1,249 @@
+#include "SceneEditor.h"
+
+#include <Core/Logger.h>
+
+#include <type_traits>
+
+namespace Nerine
+{
+
+namespace
+{
+
+bool IsAncestor(const std::vector<u32>& parents, u32 ancestor, u32 node)
+{
+    for (; node != u32(-1); node = parents[node])
+    {
+        if (node == ancestor)
+            return true;
+    }
+
+    return false;
+}
+
+} // namespace
+
+SceneEditor::SceneEditor(Scene& scene) : m_Scene(scene)
+{
+}
+
+u32 SceneEditor::AddNode(const SceneNodeDesc& desc)
+{
+    if (desc.parent != u32(-1) && !IsValidNode(desc.parent))
+    {
+        LOG_ERROR("SceneEditor::AddNode: invalid parent ", desc.parent);
+        return u32(-1);
+    }
+
+    m_AddedNodes.push_back(desc);
+    return (u32)(m_Scene.hierarchy.size() + m_AddedNodes.size() - 1);
+}
+
+void SceneEditor::DeleteNode(u32 node)
+{
+    if (!IsValidNode(node))
+    {
+        LOG_ERROR("SceneEditor::DeleteNode: invalid node ", node);
+        return;
+    }
+
+    m_DeletedNodes.push_back(node);
+}
+
+void SceneEditor::Reparent(u32 node, u32 newParent)
+{
+    if (!IsValidNode(node) || (newParent != u32(-1) && !IsValidNode(newParent)))
+    {
+        LOG_ERROR("SceneEditor::Reparent: invalid node ", node, " or parent ", newParent);
+        return;
+    }
+
+    m_Reparents.push_back({node, newParent});
+}
+
+bool SceneEditor::IsValidNode(u32 node) const
+{
+    return node < m_Scene.hierarchy.size() + m_AddedNodes.size();
+}
+
+void SceneEditor::Commit()
+{
+    auto& scene = m_Scene;
+
+    // Existing nodes followed by the pending ones.
+    const u32 oldCount = (u32)scene.hierarchy.size();
+    const u32 count = oldCount + (u32)m_AddedNodes.size();
+
+    std::vector<u32> parents(count);
+    for (u32 node = 0; node < oldCount; node++)
+        parents[node] = scene.hierarchy[node].parent;
+    for (u32 i = 0; i < m_AddedNodes.size(); i++)
+        parents[oldCount + i] = m_AddedNodes[i].parent;
+
+    std::vector<u32> movedNodes;
+    for (const auto& [node, newParent] : m_Reparents)
+    {
+        if (IsAncestor(parents, node, newParent))
+        {
+            LOG_ERROR("SceneEditor::Commit: cannot move node ", node, " below its descendant ",
+                      newParent);
+            continue;
+        }
+
+        parents[node] = newParent;
+        movedNodes.push_back(node);
+    }
+
+    std::vector<bool> deleted(count, false);
+    for (const auto node : m_DeletedNodes)
+        deleted[node] = true;
+
+    // Children of every node, in index order.
+    std::vector<u32> childOffsets(count + 1, 0);
+    for (u32 node = 0; node < count; node++)
+    {
+        if (parents[node] != u32(-1))
+            childOffsets[parents[node] + 1]++;
+    }
+    for (u32 node = 0; node < count; node++)
+        childOffsets[node + 1] += childOffsets[node];
+
+    std::vector<u32> children(childOffsets[count]);
+    {
+        std::vector<u32> cursors(childOffsets.begin(), childOffsets.end() - 1);
+        for (u32 node = 0; node < count; node++)
+        {
+            if (parents[node] != u32(-1))
+                children[cursors[parents[node]]++] = node;
+        }
+    }
+
+    // Breadth first walk from the roots, deleted nodes and their subtrees are never reached.
+    // order[newIndex] = node.
+    std::vector<u32> order;
+    order.reserve(count);
+    for (u32 node = 0; node < count; node++)
+    {
+        if (parents[node] == u32(-1) && !deleted[node])
+            order.push_back(node);
+    }
+
+    std::vector<u32> levelOffsets = {0};
+    for (size_t levelBegin = 0; levelBegin < order.size();)
+    {
+        const size_t levelEnd = order.size();
+        levelOffsets.push_back((u32)levelEnd);
+
+        for (size_t i = levelBegin; i < levelEnd; i++)
+        {
+            for (u32 c = childOffsets[order[i]]; c < childOffsets[order[i] + 1]; c++)
+            {
+                if (!deleted[children[c]])
+                    order.push_back(children[c]);
+            }
+        }
+
+        levelBegin = levelEnd;
+    }
+
+    const u32 newCount = (u32)order.size();
+
+    m_Remap.assign(count, u32(-1));
+    for (u32 i = 0; i < newCount; i++)
+        m_Remap[order[i]] = i;
+
+    // Siblings are contiguous in breadth first order, links follow from the parents alone.
+    std::vector<SceneHierarchy> hierarchy(newCount);
+    for (u32 level = 0; level + 1 < levelOffsets.size(); level++)
+    {
+        for (u32 i = levelOffsets[level]; i < levelOffsets[level + 1]; i++)
+        {
+            const u32 parent = parents[order[i]];
+            auto& h = hierarchy[i];
+            h.level = level;
+
+            if (parent == u32(-1))
+                continue;
+
+            h.parent = m_Remap[parent];
+            auto& p = hierarchy[h.parent];
+            if (p.firstChild == u32(-1))
+            {
+                p.firstChild = i;
+                h.lastSibling = i;
+            }
+            else
+            {
+                hierarchy[i - 1].nextSibling = i;
+                hierarchy[p.firstChild].lastSibling = i;
+            }
+        }
+    }
+
+    auto Gather = [&](auto& items, const auto& addedValue) {
+        std::remove_reference_t<decltype(items)> gathered(newCount);
+        for (u32 i = 0; i < newCount; i++)
+        {
+            const u32 node = order[i];
+            gathered[i]
+                = (node < oldCount) ? items[node] : addedValue(m_AddedNodes[node - oldCount]);
+        }
+        items.swap(gathered);
+    };
+
+    // Added nodes get their local transform below, TRS scenes decompose it.
+    if (scene.useTRS)
+    {
+        Gather(scene.localTranslations, [](const SceneNodeDesc&) { return vec3(0.0f); });
+        Gather(scene.localRotations,
+               [](const SceneNodeDesc&) { return quat(1.0f, 0.0f, 0.0f, 0.0f); });
+        Gather(scene.localScales, [](const SceneNodeDesc&) { return vec3(1.0f); });
+    }
+    else
+    {
+        Gather(scene.localTransforms, [](const SceneNodeDesc&) { return mat4(1.0f); });
+    }
+    Gather(scene.globalTransforms, [](const SceneNodeDesc&) { return mat4(1.0f); });
+    Gather(scene.nodeMeshes, [](const SceneNodeDesc& desc) { return desc.mesh; });
+    Gather(scene.nodeMaterials, [](const SceneNodeDesc& desc) { return desc.material; });
+    Gather(scene.nodeNames, [&scene](const SceneNodeDesc& desc) {
+        return desc.name.empty() ? u32(-1) : scene.names.Intern(desc.name);
+    });
+
+    for (u32 i = 0; i < m_AddedNodes.size(); i++)
+    {
+        const u32 node = m_Remap[oldCount + i];
+        if (node != u32(-1))
+            SetLocalTransform(scene, node, m_AddedNodes[i].localTransform);
+    }
+
+    scene.hierarchy.swap(hierarchy);
+    scene.levelOffsets = std::move(levelOffsets);
+    RebuildNameIndex(scene);
+
+    // Pending changes follow their nodes, moved and added nodes need new global transforms.
+    std::vector<u32> changedNodes;
+    for (auto& nodes : scene.changedAtThisFrame)
+    {
+        for (const auto node : nodes)
+            changedNodes.push_back(m_Remap[node]);
+        nodes.clear();
+    }
+    for (const auto node : movedNodes)
+        changedNodes.push_back(m_Remap[node]);
+    for (u32 node = oldCount; node < count; node++)
+        changedNodes.push_back(m_Remap[node]);
+
+    scene.dirtyNodes.assign(newCount, false);
+    for (const auto node : changedNodes)
+    {
+        if (node != u32(-1))
+            MarkAsChanged(scene, node);
+    }
+
+    m_AddedNodes.clear();
+    m_DeletedNodes.clear();
+    m_Reparents.clear();
+}
+
+} // namespace Nerine
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Scene.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Nerine
+{
+
+/*
+ * Node added through SceneEditor. parent is an existing node, a pending node id returned by
+ * SceneEditor::AddNode or u32(-1) for a new root.
+ */
+struct SceneNodeDesc
+{
+    u32 parent{u32(-1)};
+    // Decomposed in scenes with TRS local transforms.
+    mat4 localTransform{1.0f};
+
+    u32 mesh{u32(-1)};
+    u32 material{u32(-1)};
+    std::string name;
+};
+
+/*
+ * Queues node additions, deletions and reparenting and applies them to the scene in a single
+ * pass on Commit(). The pass is linear in the node count: it rebuilds the hierarchy breadth
+ * first, so the scene stays depth sorted, and moves every per node array through one remap table.
+ *
+ * The scene must not be modified by other means while edits are queued.
+ */
+class SceneEditor
+{
+public:
+    explicit SceneEditor(Scene& scene);
+
+    NON_COPYABLE(SceneEditor);
+
+    /*
+     * Returns the pending id of the node, valid as a parent or edit target until Commit().
+     * Pending ids follow the ids of the existing nodes.
+     */
+    u32 AddNode(const SceneNodeDesc& desc);
+
+    /*
+     * Deletes the node together with its subtree.
+     */
+    void DeleteNode(u32 node);
+
+    /*
+     * Moves the node, with its subtree, below newParent, u32(-1) makes it a root. The local
+     * transform is kept, so the global transform changes. Moves that would create a cycle are
+     * dropped at commit time.
+     */
+    void Reparent(u32 node, u32 newParent);
+
+    void Commit();
+
+    /*
+     * Index after the last Commit() of an existing node or pending id, u32(-1) if it was deleted.
+     */
+    [[nodiscard]] u32 GetNewIndex(u32 node) const
+    {
+        return (node < m_Remap.size()) ? m_Remap[node] : u32(-1);
+    }
+
+private:
+    [[nodiscard]] bool IsValidNode(u32 node) const;
+
+    Scene& m_Scene;
+
+    std::vector<SceneNodeDesc> m_AddedNodes;
+    std::vector<u32> m_DeletedNodes;
+    // (node, new parent)
+    std::vector<std::pair<u32, u32>> m_Reparents;
+
+    std::vector<u32> m_Remap;
+};
+
+} // namespace Nerine
@@ -0,0 +1,338 @@
+#include "TextureCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace Nerine
+{
+
+namespace
+{
+
+constexpr u32 BLOCK_DIMENSION = 4;
+constexpr u32 BLOCK_PIXELS = BLOCK_DIMENSION * BLOCK_DIMENSION;
+
+u16 PackRGB565(const vec3& color)
+{
+    const u32 r = (u32)std::clamp((int)std::lround(color.x * 31.0f / 255.0f), 0, 31);
+    const u32 g = (u32)std::clamp((int)std::lround(color.y * 63.0f / 255.0f), 0, 63);
+    const u32 b = (u32)std::clamp((int)std::lround(color.z * 31.0f / 255.0f), 0, 31);
+
+    return (u16)((r << 11) | (g << 5) | b);
+}
+
+vec3 UnpackRGB565(u16 color)
+{
+    const u32 r = (color >> 11) & 31;
+    const u32 g = (color >> 5) & 63;
+    const u32 b = color & 31;
+
+    return vec3((float)((r << 3) | (r >> 2)), (float)((g << 2) | (g >> 4)),
+                (float)((b << 3) | (b >> 2)));
+}
+
+/*
+ * Picks the closest palette entry of every pixel for the endpoints, returns the squared error.
+ * The endpoints are ordered so the block always decodes in four color mode.
+ */
+float FindBC1Indices(const vec3 pixels[BLOCK_PIXELS], u16& color0, u16& color1, u32& indices)
+{
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    vec3 palette[4];
+    palette[0] = UnpackRGB565(color0);
+    palette[1] = UnpackRGB565(color1);
+    palette[2] = (2.0f * palette[0] + palette[1]) / 3.0f;
+    palette[3] = (palette[0] + 2.0f * palette[1]) / 3.0f;
+
+    // Equal endpoints decode in three color mode, only index 0 is safe to use there.
+    const u32 paletteSize = (color0 == color1) ? 1 : 4;
+
+    float error = 0.0f;
+    indices = 0;
+
+    for (u32 i = 0; i < BLOCK_PIXELS; i++)
+    {
+        u32 best = 0;
+        float bestDistance = std::numeric_limits<float>::max();
+        for (u32 p = 0; p < paletteSize; p++)
+        {
+            const vec3 d = pixels[i] - palette[p];
+            const float distance = glm::dot(d, d);
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                best = p;
+            }
+        }
+
+        indices |= best << (2 * i);
+        error += bestDistance;
+    }
+
+    return error;
+}
+
+/*
+ * Least squares fit of the endpoints to the pixels for fixed indices.
+ */
+bool RefineBC1Endpoints(const vec3 pixels[BLOCK_PIXELS], u32 indices, vec3& endpoint0,
+                        vec3& endpoint1)
+{
+    // Weight of endpoint 0 for each index.
+    static constexpr float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+
+    float a = 0.0f;
+    float b = 0.0f;
+    float c = 0.0f;
+    vec3 x(0.0f);
+    vec3 y(0.0f);
+
+    for (u32 i = 0; i < BLOCK_PIXELS; i++)
+    {
+        const float w = weights[(indices >> (2 * i)) & 3];
+        a += w * w;
+        b += w * (1.0f - w);
+        c += (1.0f - w) * (1.0f - w);
+        x += w * pixels[i];
+        y += (1.0f - w) * pixels[i];
+    }
+
+    const float determinant = a * c - b * b;
+    if (std::abs(determinant) < 1e-6f)
+        return false;
+
+    endpoint0 = glm::clamp((x * c - y * b) / determinant, 0.0f, 255.0f);
+    endpoint1 = glm::clamp((y * a - x * b) / determinant, 0.0f, 255.0f);
+
+    return true;
+}
+
+void WriteBC1Block(u16 color0, u16 color1, u32 indices, u8* dst)
+{
+    memcpy(dst, &color0, sizeof(color0));
+    memcpy(dst + 2, &color1, sizeof(color1));
+    memcpy(dst + 4, &indices, sizeof(indices));
+}
+
+/*
+ * Endpoints are fitted along the principal axis of the block colors, then refined once with a
+ * least squares fit to the resulting indices.
+ */
+void EncodeBC1Block(const u8* rgba, u8* dst)
+{
+    vec3 pixels[BLOCK_PIXELS];
+    vec3 mean(0.0f);
+    vec3 minColor(255.0f);
+    vec3 maxColor(0.0f);
+
+    for (u32 i = 0; i < BLOCK_PIXELS; i++)
+    {
+        pixels[i] = vec3(rgba[i * 4 + 0], rgba[i * 4 + 1], rgba[i * 4 + 2]);
+        mean += pixels[i];
+        minColor = glm::min(minColor, pixels[i]);
+        maxColor = glm::max(maxColor, pixels[i]);
+    }
+    mean /= (float)BLOCK_PIXELS;
+
+    if (minColor == maxColor)
+    {
+        u16 color = PackRGB565(minColor);
+        u16 unused = color;
+        u32 indices = 0;
+        FindBC1Indices(pixels, color, unused, indices);
+        WriteBC1Block(color, unused, indices, dst);
+        return;
+    }
+
+    // Covariance of the block colors.
+    float cov[6] = {};
+    for (u32 i = 0; i < BLOCK_PIXELS; i++)
+    {
+        const vec3 d = pixels[i] - mean;
+        cov[0] += d.x * d.x;
+        cov[1] += d.x * d.y;
+        cov[2] += d.x * d.z;
+        cov[3] += d.y * d.y;
+        cov[4] += d.y * d.z;
+        cov[5] += d.z * d.z;
+    }
+
+    // Principal axis by power iteration, starting from the bounding box diagonal.
+    vec3 axis = maxColor - minColor;
+    for (u32 iteration = 0; iteration < 8; iteration++)
+    {
+        const vec3 next(cov[0] * axis.x + cov[1] * axis.y + cov[2] * axis.z,
+                        cov[1] * axis.x + cov[3] * axis.y + cov[4] * axis.z,
+                        cov[2] * axis.x + cov[4] * axis.y + cov[5] * axis.z);
+        const float length = glm::length(next);
+        if (length < 1e-6f)
+            break;
+        axis = next / length;
+    }
+    axis = glm::normalize(axis);
+
+    float minProjection = std::numeric_limits<float>::max();
+    float maxProjection = std::numeric_limits<float>::lowest();
+    for (u32 i = 0; i < BLOCK_PIXELS; i++)
+    {
+        const float projection = glm::dot(pixels[i] - mean, axis);
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+
+    // Pull the endpoints slightly inwards, the interpolated colors cover the range better.
+    const float inset = (maxProjection - minProjection) / 16.0f;
+    vec3 endpoint0 = glm::clamp(mean + axis * (maxProjection - inset), 0.0f, 255.0f);
+    vec3 endpoint1 = glm::clamp(mean + axis * (minProjection + inset), 0.0f, 255.0f);
+
+    u16 color0 = PackRGB565(endpoint0);
+    u16 color1 = PackRGB565(endpoint1);
+    u32 indices = 0;
+    const float error = FindBC1Indices(pixels, color0, color1, indices);
+
+    if (RefineBC1Endpoints(pixels, indices, endpoint0, endpoint1))
+    {
+        u16 refinedColor0 = PackRGB565(endpoint0);
+        u16 refinedColor1 = PackRGB565(endpoint1);
+        u32 refinedIndices = 0;
+        const float refinedError
+            = FindBC1Indices(pixels, refinedColor0, refinedColor1, refinedIndices);
+
+        if (refinedError < error)
+        {
+            color0 = refinedColor0;
+            color1 = refinedColor1;
+            indices = refinedIndices;
+        }
+    }
+
+    WriteBC1Block(color0, color1, indices, dst);
+}
+
+/*
+ * Encodes one channel in eight value mode, the endpoints are the block minimum and maximum.
+ */
+void EncodeBC4Block(const u8 values[BLOCK_PIXELS], u8* dst)
+{
+    const auto [minValue, maxValue] = std::minmax_element(values, values + BLOCK_PIXELS);
+
+    dst[0] = *maxValue;
+    dst[1] = *minValue;
+
+    u64 indices = 0;
+    if (*maxValue != *minValue)
+    {
+        u32 palette[8];
+        palette[0] = *maxValue;
+        palette[1] = *minValue;
+        for (u32 i = 1; i < 7; i++)
+            palette[i + 1] = ((7 - i) * palette[0] + i * palette[1] + 3) / 7;
+
+        for (u32 i = 0; i < BLOCK_PIXELS; i++)
+        {
+            u64 best = 0;
+            u32 bestDistance = ~0u;
+            for (u32 p = 0; p < 8; p++)
+            {
+                const u32 distance = (u32)std::abs((int)values[i] - (int)palette[p]);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+
+            indices |= best << (3 * i);
+        }
+    }
+
+    // 48 bits of indices.
+    for (u32 i = 0; i < 6; i++)
+        dst[2 + i] = (u8)(indices >> (8 * i));
+}
+
+void EncodeBC4Channel(const u8* rgba, u32 channel, u8* dst)
+{
+    u8 values[BLOCK_PIXELS];
+    for (u32 i = 0; i < BLOCK_PIXELS; i++)
+        values[i] = rgba[i * 4 + channel];
+
+    EncodeBC4Block(values, dst);
+}
+
+} // namespace
+
+u32 GetBlockSize(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1:
+    case BlockFormat::BC4:
+        return 8;
+    case BlockFormat::BC3:
+    case BlockFormat::BC5:
+        return 16;
+    }
+
+    return 0;
+}
+
+size_t GetCompressedImageSize(BlockFormat format, u32 width, u32 height)
+{
+    const size_t blocksX = (width + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+    const size_t blocksY = (height + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+
+    return std::max<size_t>(blocksX, 1) * std::max<size_t>(blocksY, 1) * GetBlockSize(format);
+}
+
+void CompressImage(BlockFormat format, const u8* rgba, u32 width, u32 height, u8* dst)
+{
+    const u32 blocksX = std::max<u32>((width + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION, 1);
+    const u32 blocksY = std::max<u32>((height + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION, 1);
+    const u32 blockSize = GetBlockSize(format);
+
+    u8 block[BLOCK_PIXELS * 4];
+
+    for (u32 by = 0; by < blocksY; by++)
+    {
+        for (u32 bx = 0; bx < blocksX; bx++)
+        {
+            for (u32 y = 0; y < BLOCK_DIMENSION; y++)
+            {
+                for (u32 x = 0; x < BLOCK_DIMENSION; x++)
+                {
+                    const u32 srcX = std::min(bx * BLOCK_DIMENSION + x, width - 1);
+                    const u32 srcY = std::min(by * BLOCK_DIMENSION + y, height - 1);
+                    memcpy(&block[(y * BLOCK_DIMENSION + x) * 4],
+                           &rgba[((size_t)srcY * width + srcX) * 4], 4);
+                }
+            }
+
+            u8* blockDst = dst + ((size_t)by * blocksX + bx) * blockSize;
+
+            switch (format)
+            {
+            case BlockFormat::BC1:
+                EncodeBC1Block(block, blockDst);
+                break;
+            case BlockFormat::BC3:
+                EncodeBC4Channel(block, 3, blockDst);
+                EncodeBC1Block(block, blockDst + 8);
+                break;
+            case BlockFormat::BC4:
+                EncodeBC4Channel(block, 0, blockDst);
+                break;
+            case BlockFormat::BC5:
+                EncodeBC4Channel(block, 0, blockDst);
+                EncodeBC4Channel(block, 1, blockDst + 8);
+                break;
+            }
+        }
+    }
+}
+
+} // namespace Nerine
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Core/Types.h>
+
+namespace Nerine
+{
+
+/*
+ * Block compressed formats produced by the CPU encoder. Every format encodes 4x4 pixel blocks.
+ */
+enum class BlockFormat : u8
+{
+    // RGB, 8 bytes per block.
+    BC1,
+    // RGBA, BC1 color block with a BC4 alpha block, 16 bytes per block.
+    BC3,
+    // Single channel (red), 8 bytes per block.
+    BC4,
+    // Two channels (red, green), two BC4 blocks, 16 bytes per block.
+    BC5,
+};
+
+u32 GetBlockSize(BlockFormat format);
+
+/*
+ * Size of the compressed image in bytes, partial blocks at the right and bottom edge count as
+ * whole blocks.
+ */
+size_t GetCompressedImageSize(BlockFormat format, u32 width, u32 height);
+
+/*
+ * Compresses a tightly packed RGBA8 image into dst, which must hold GetCompressedImageSize bytes.
+ * Blocks are stored row by row. Partial edge blocks repeat the edge pixels.
+ */
+void CompressImage(BlockFormat format, const u8* rgba, u32 width, u32 height, u8* dst);
+
+} // namespace Nerine
@@ -32,24 +32,7 @@ void LoadStringArray(std::ifstream& file, std::vector<std::string>& arr)
     }
 }
 
-void SaveMap(std::ofstream& file, const std::unordered_map<u32, u32>& map)
-{
-    std::vector<u32> ms;
-    ms.reserve(map.size() * 2);
-
-    for (const auto& m : map)
-    {
-        ms.push_back(m.first);
-        ms.push_back(m.second);
-    }
-
-    const u32 size = static_cast<u32>(ms.size());
-
-    file.write((char*)&size, sizeof(size));
-    file.write((char*)ms.data(), sizeof(u32) * ms.size());
-}
-
-void LoadMap(std::ifstream& file, std::unordered_map<u32, u32>& map)
+void LoadComponentArray(std::ifstream& file, std::vector<u32>& components)
 {
     u32 size = 0;
     file.read((char*)&size, sizeof(size));
@@ -57,8 +40,13 @@ void LoadMap(std::ifstream& file, std::unordered_map<u32, u32>& map)
     std::vector<u32> ms(size);
     file.read((char*)ms.data(), sizeof(u32) * size);
 
+    std::fill(components.begin(), components.end(), u32(-1));
     for (auto i = 0; i < (size / 2); i++)
-        map[ms[i * 2]] = ms[(i * 2) + 1];
+    {
+        const u32 node = ms[i * 2];
+        if (node < components.size())
+            components[node] = ms[(i * 2) + 1];
+    }
 }
 
 } // namespace Nerine
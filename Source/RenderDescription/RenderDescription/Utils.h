@@ -1,8 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <fstream>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include <Core/Types.h>
@@ -16,8 +16,12 @@ namespace Nerine
 void SaveStringArray(std::ofstream& file, const std::vector<std::string>& arr);
 void LoadStringArray(std::ifstream& file, std::vector<std::string>& arr);
 
-void SaveMap(std::ofstream& file, const std::unordered_map<u32, u32>& map);
-void LoadMap(std::ifstream& file, std::unordered_map<u32, u32>& map);
+/*
+ * Reader of the unversioned scene file components. Per node component arrays are stored sparsely
+ * as (node, value) pairs of the nodes that have the component. The array has to be sized to the
+ * node count beforehand.
+ */
+void LoadComponentArray(std::ifstream& file, std::vector<u32>& components);
 
 /*
  * Adds if name is not in array.